@@ -0,0 +1,115 @@
+#include "Resampling.h"
+#include "../common/ResultCache.h"
+
+using namespace std;
+
+/**
+ * Command line front end: resample without a window and write the result
+ * as a planar .rgb file.
+ * ./Resample input.rgb width height O1|O2|O3 output.rgb
+ * ./Resample --sequence frames.rgb width height O1|O2|O3 output.rgb [threads]
+ * ./Resample --multi input.rgb width height O1|O2|O3 output.rgb [O1|O2|O3 output.rgb ...]
+ * Any form may start with --fixed-kernel to down sample with the 5x5
+ * Gaussian kernel instead of the pyramid. Single images (not sequences)
+ * are reused from $IMAGE_CACHE_DIR when it is set.
+ */
+int main(int argc, char **argv) {
+  if (argc >= 2 && string(argv[1]) == "--fixed-kernel") {
+    pyramidDownsample = false;
+    argv[1] = argv[0];
+    argv++;
+    argc--;
+  }
+  if (argc >= 7 && argc <= 8 && string(argv[1]) == "--sequence") {
+    int outWidth;
+    int outHeight;
+    if (!outputFormatSize(argv[5], outWidth, outHeight)) {
+      cerr << "Output format not O1, O2, or O3. Exiting..." << endl;
+      return 1;
+    }
+    int threads = (argc == 8) ? atoi(argv[7]) : 0;
+    if (!resampleSequence(argv[2], atoi(argv[3]), atoi(argv[4]), outWidth, outHeight, argv[6], threads)) {
+      cerr << "Error Opening File for Writing" << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (argc >= 7 && argc % 2 == 1 && string(argv[1]) == "--multi") {
+    //Format / output pairs, the input is read and resampled once for all of them
+    vector<pair<int, int>> outSizes;
+    vector<string> outPaths;
+    for (int i = 5; i < argc; i += 2) {
+      int outWidth;
+      int outHeight;
+      if (!outputFormatSize(argv[i], outWidth, outHeight)) {
+        cerr << "Output format not O1, O2, or O3. Exiting..." << endl;
+        return 1;
+      }
+      outSizes.push_back(make_pair(outWidth, outHeight));
+      outPaths.push_back(argv[i + 1]);
+    }
+    int inWidth = atoi(argv[3]);
+    int inHeight = atoi(argv[4]);
+    //Only the formats the cache does not have are resampled
+    ResultCache cache;
+    vector<string> keys;
+    vector<size_t> missing;
+    vector<pair<int, int>> missingSizes;
+    for (size_t i = 0; i < outSizes.size(); i++) {
+      if (!canResample(inWidth, outSizes[i].first)) {
+        cerr << "Cannot resample " << argv[2] << " to " << argv[5 + 2 * i] << endl;
+        return 1;
+      }
+      keys.push_back(cache.key(argv[2], inWidth, inHeight, resampleOperation(inWidth, inHeight, outSizes[i].first, outSizes[i].second)));
+      if (cache.copyTo(keys[i], outPaths[i])) {
+        cout << "Served " << outPaths[i] << " from the result cache" << endl;
+      } else {
+        missing.push_back(i);
+        missingSizes.push_back(outSizes[i]);
+      }
+    }
+    if (missing.empty()) {
+      return 0;
+    }
+    vector<ResampledImage> images = resampleImageSizes(argv[2], inWidth, inHeight, missingSizes);
+    for (size_t j = 0; j < images.size(); j++) {
+      size_t i = missing[j];
+      if (!writeResampledImage(outPaths[i], images[j])) {
+        cerr << "Error Opening File for Writing" << endl;
+        return 1;
+      }
+      cache.storeFile(keys[i], outPaths[i]);
+      cout << "Wrote " << images[j].width << "x" << images[j].height << " to " << outPaths[i] << endl;
+    }
+    return 0;
+  }
+  if (argc != 6 || argv[1][0] == '-') {
+    cerr << "Usage: " << argv[0] << " [--fixed-kernel] input.rgb width height O1|O2|O3 output.rgb" << endl;
+    cerr << "       " << argv[0] << " [--fixed-kernel] --sequence frames.rgb width height O1|O2|O3 output.rgb [threads]" << endl;
+    cerr << "       " << argv[0] << " [--fixed-kernel] --multi input.rgb width height O1|O2|O3 output.rgb [O1|O2|O3 output.rgb ...]" << endl;
+    return 1;
+  }
+  string imagePath = argv[1];
+  int inWidth = atoi(argv[2]);
+  int inHeight = atoi(argv[3]);
+  int outWidth;
+  int outHeight;
+  if (!outputFormatSize(argv[4], outWidth, outHeight)) {
+    cerr << "Output format not O1, O2, or O3. Exiting..." << endl;
+    return 1;
+  }
+  ResultCache cache;
+  string key = cache.key(imagePath, inWidth, inHeight, resampleOperation(inWidth, inHeight, outWidth, outHeight));
+  if (cache.copyTo(key, argv[5])) {
+    cout << "Served from the result cache" << endl;
+    return 0;
+  }
+  unsigned char *outData = resampleImage(imagePath, inWidth, inHeight, outWidth, outHeight);
+  if (outData == NULL || !writePlanarRGB(argv[5], outData, outWidth, outHeight)) {
+    cerr << "Error Opening File for Writing" << endl;
+    return 1;
+  }
+  free(outData);
+  cache.storeFile(key, argv[5]);
+  return 0;
+}
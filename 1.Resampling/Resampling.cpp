@@ -0,0 +1,649 @@
+#include "Resampling.h"
+
+using namespace std;
+
+bool resampleLog = true;
+bool pyramidDownsample = true;
+
+/** Function to map an output format to its size: O1 --> 1920x1080, O2 --> 1280x720, O3 --> 640x480 */
+bool outputFormatSize(string format, int &outWidth, int &outHeight){
+  if (format == "O1"){
+    outWidth = 1920;
+    outHeight = 1080;
+  } else if (format == "O2"){
+    outWidth = 1280;
+    outHeight = 720;
+  } else if (format == "O3"){
+    outWidth = 640;
+    outHeight = 480;
+  } else {
+    return false;
+  }
+  return true;
+}
+/** Function to describe a resample for the result cache */
+string resampleOperation(int width, int height, int outWidth, int outHeight){
+  return "resample v1 " + string(pyramidDownsample ? "pyramid " : "kernel5 ") + to_string(width) + "x" + to_string(height) + " -> " +
+         to_string(outWidth) + "x" + to_string(outHeight);
+}
+/** Function to create a 2D kernel **/
+double gaussian( double x, double mu, double sigma ) {
+    const double a = ( x - mu ) / sigma;
+    return exp( -0.5 * a * a );
+}
+vector<vector<double>> create2DKernel(int kernelSize){
+  TRACE_SCOPE("kernel create");
+typedef vector<double> kernel_row;
+typedef vector<kernel_row> kernel_type;
+  double kernelRadius = kernelSize/2;
+  double sigma = kernelRadius/2.;
+  kernel_type kernel2d(2*kernelRadius+1, kernel_row(2*kernelRadius+1));
+  double sum = 0;
+  // compute values
+  for (int row = 0; row < kernel2d.size(); row++)
+    for (int col = 0; col < kernel2d[row].size(); col++) {
+      double x = gaussian(row, kernelRadius, sigma) * gaussian(col, kernelRadius, sigma);
+      kernel2d[row][col] = x;
+      sum += x;
+    }
+  // normalize
+  for (int row = 0; row < kernel2d.size(); row++){
+    for (int col = 0; col < kernel2d[row].size(); col++){
+      kernel2d[row][col] /= sum;
+    }
+  }
+  if (resampleLog){
+    cout<<"Created 2D kernel of size: " << kernelSize <<endl;
+  }
+  return kernel2d;
+}
+/** Function to apply kernel**/
+vector<vector<unsigned char>> applyKernel(vector<vector<unsigned char>> image2D,vector<vector<double>> kernel, int kernelSize, int height,int width) {
+  TRACE_SCOPE("kernel");
+  vector<vector<unsigned char>> output(height, vector<unsigned char>(width));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double sum = 0.0;
+            for (int i = -1 * (kernelSize / 2); i <= (kernelSize / 2); i++) {
+                for (int j = -1 * (kernelSize / 2); j <= (kernelSize / 2); j++) {
+                    int sourceY = y + i;
+                    int sourceX = x + j;
+
+                    // Mirror border pixels
+                    if (sourceY < 0) {
+                        sourceY = 0;
+                    } else if (sourceY >= height) {
+                        sourceY =  height - 1;
+                        //sourceY = 2 * height - sourceY - 2; 
+                    }
+                    if (sourceX < 0) {
+                        sourceX = 0;
+                    } else if (sourceX >= width) {
+                        sourceX =  width - 1;
+                        //sourceX = 2 * width - sourceX - 2;
+                    }
+                    sum += static_cast<int>(image2D[sourceY][sourceX]) * kernel[i + (kernelSize / 2)][j + (kernelSize / 2)];
+                }
+                output[y][x] = static_cast<unsigned char>(sum);
+            }
+        }
+    }
+    if (resampleLog){
+      cout<<"Applied Gaussian Kernel to Red/Green/Blue Channel"<<endl;
+    }
+    return output;
+}
+/**Downsample O1&O2**/
+vector<vector<unsigned char>> scaleDownO12(vector<vector<unsigned char>> input, int height, int width, int outHeight, int outWidth){
+  TRACE_SCOPE("scale down O1/O2");
+  vector<vector<unsigned char>> output(outHeight, vector<unsigned char>(outWidth));
+  double power = 10;
+  double xStep = static_cast<double> (width) / outWidth;
+  double yStep =  static_cast<double> (height) / outHeight;
+
+  double xCenter = outWidth/2;
+  double yCenter = outHeight/2;
+
+  double ogX;
+  double ogY;
+  double nonLinearStretchX;
+  double nonLinearStretchY;
+
+  for (double y = 0; y < outHeight; y++) {
+    for (double x = 0; x < outWidth; x++) {
+      double normalDistX = abs(x - xCenter) / xCenter;
+      double normalDistY = abs(y - yCenter) / yCenter;
+      
+      nonLinearStretchX = tanh(normalDistX*0.5) * power;
+      nonLinearStretchY = tanh(normalDistY*0.5) * power;
+      //nonLinearStretchX = (x/(1+abs(x)));
+      //nonLinearStretchY = (y/(1+abs(y)));
+
+      //cout<<"x: "<< x << " --- y: " << y << endl;
+      //cout<<"stetchX "<< nonLinearStretchY << " --- stetchY: " << nonLinearStretchY << endl;
+      ogX = (nonLinearStretchX + x) * xStep;
+      ogY = (nonLinearStretchY + y) * yStep;
+
+      ogX = clamp(ogX, 0.0, width - 1.0);
+      ogY = clamp(ogY, 0.0, height - 1.0);
+
+      output[y][x] = input[ogY][ogX];  
+    }
+  }
+  if (resampleLog){
+    cout<<"Down Sampled Red/Green/Blue Channel"<<endl;
+  }
+  return output;
+}
+/**Downsample O3**/
+vector<vector<unsigned char>> scaleDownO3(vector<vector<unsigned char>> input, int height, int width, int outHeight, int outWidth){
+  TRACE_SCOPE("scale down O3");
+  vector<vector<unsigned char>> output(outHeight, vector<unsigned char>(outWidth));
+    int stepX = width / outWidth;
+    int stepY = height / outHeight;
+
+    for (int y = 0; y < outHeight; y++) {
+        for (int x = 0; x < outWidth; x++) {
+            int ogX = x * stepX;
+            int ogY = y * stepY;
+            output[y][x] = input[ogY][ogX];
+        }
+    }
+    if (resampleLog){
+      cout<<"Down Sampled Red/Green/Blue Channel"<<endl;
+    }
+    return output;
+}
+/**Halve the width: output column x is centered between input columns 2x and 2x + 1**/
+vector<vector<unsigned char>> halveWidth(const vector<vector<unsigned char>> &input, int height, int width){
+  TRACE_SCOPE("pyramid halve width");
+  int outWidth = (width + 1) / 2;
+  vector<vector<unsigned char>> output(height, vector<unsigned char>(outWidth));
+  for (int y = 0; y < height; y++){
+    const unsigned char *in = input[y].data();
+    unsigned char *out = output[y].data();
+    //Interior columns need no clamping
+    int last = (width - 3) / 2;
+    for (int x = 1; x <= last; x++){
+      const unsigned char *p = in + 2 * x - 1;
+      out[x] = static_cast<unsigned char>((p[0] + 3 * p[1] + 3 * p[2] + p[3] + 4) >> 3);
+    }
+    //Clamp at the borders like applyKernel
+    for (int x = 0; x < outWidth; x = (x == 0 && last >= 1) ? last + 1 : x + 1){
+      int a = max(2 * x - 1, 0);
+      int b = 2 * x;
+      int c = min(2 * x + 1, width - 1);
+      int d = min(2 * x + 2, width - 1);
+      out[x] = static_cast<unsigned char>((in[a] + 3 * in[b] + 3 * in[c] + in[d] + 4) >> 3);
+    }
+  }
+  return output;
+}
+/**Halve the height, whole rows at a time**/
+vector<vector<unsigned char>> halveHeight(const vector<vector<unsigned char>> &input, int height, int width){
+  TRACE_SCOPE("pyramid halve height");
+  int outHeight = (height + 1) / 2;
+  vector<vector<unsigned char>> output(outHeight, vector<unsigned char>(width));
+  for (int y = 0; y < outHeight; y++){
+    const unsigned char *a = input[max(2 * y - 1, 0)].data();
+    const unsigned char *b = input[2 * y].data();
+    const unsigned char *c = input[min(2 * y + 1, height - 1)].data();
+    const unsigned char *d = input[min(2 * y + 2, height - 1)].data();
+    unsigned char *out = output[y].data();
+    for (int x = 0; x < width; x++){
+      out[x] = static_cast<unsigned char>((a[x] + 3 * b[x] + 3 * c[x] + d[x] + 4) >> 3);
+    }
+  }
+  return output;
+}
+/**Output pixel positions in the input: O1/O2 keep the stretch of scaleDownO12, anything else maps pixel centers evenly**/
+vector<double> downsamplePositions(int size, int outSize, bool stretch){
+  vector<double> positions(outSize);
+  double step = static_cast<double>(size) / outSize;
+  double center = outSize / 2;
+  double power = 10;
+  for (int i = 0; i < outSize; i++){
+    if (stretch){
+      positions[i] = (tanh(abs(i - center) / center * 0.5) * power + i) * step;
+    } else {
+      positions[i] = (i + 0.5) * step - 0.5;
+    }
+    positions[i] = clamp(positions[i], 0.0, size - 1.0);
+  }
+  return positions;
+}
+/** Taps and normalized tent weights of one output pixel along one axis */
+struct FilterTaps {
+  vector<int> index;    //already clamped to the level
+  vector<float> weight;
+};
+static vector<FilterTaps> tentTaps(const vector<double> &positions, int size, double scale){
+  //Radius 1 is plain linear interpolation, wider once the residual step exceeds a pixel
+  double radius = max(1.0, scale);
+  vector<FilterTaps> taps(positions.size());
+  for (size_t i = 0; i < positions.size(); i++){
+    double center = positions[i];
+    int first = static_cast<int>(ceil(center - radius));
+    int last = static_cast<int>(floor(center + radius));
+    double sum = 0;
+    vector<double> weights;
+    for (int j = first; j <= last; j++){
+      double w = max(0.0, 1 - abs(j - center) / radius);
+      weights.push_back(w);
+      sum += w;
+    }
+    for (int j = first; j <= last; j++){
+      taps[i].index.push_back(clamp(j, 0, size - 1));
+      taps[i].weight.push_back(static_cast<float>(weights[j - first] / sum));
+    }
+  }
+  return taps;
+}
+/**Fractional pass: vertical then horizontal tent filter**/
+vector<vector<unsigned char>> resampleFractional(const vector<vector<unsigned char>> &level, int height, int width, const vector<double> &xPositions,
+                                                 const vector<double> &yPositions, double xScale, double yScale){
+  TRACE_SCOPE("scale down fractional");
+  int outWidth = xPositions.size();
+  int outHeight = yPositions.size();
+  vector<FilterTaps> xTaps = tentTaps(xPositions, width, xScale);
+  vector<FilterTaps> yTaps = tentTaps(yPositions, height, yScale);
+  vector<vector<unsigned char>> output(outHeight, vector<unsigned char>(outWidth));
+  //Vertical first: whole rows at a time, and the gathering horizontal pass only runs on output rows
+  vector<float> row(width);
+  for (int y = 0; y < outHeight; y++){
+    const FilterTaps &t = yTaps[y];
+    fill(row.begin(), row.end(), 0.0f);
+    for (size_t k = 0; k < t.index.size(); k++){
+      const unsigned char *in = level[t.index[k]].data();
+      float w = t.weight[k];
+      for (int x = 0; x < width; x++){
+        row[x] += in[x] * w;
+      }
+    }
+    unsigned char *out = output[y].data();
+    for (int x = 0; x < outWidth; x++){
+      const FilterTaps &h = xTaps[x];
+      float sum = 0.5f;
+      for (size_t k = 0; k < h.index.size(); k++){
+        sum += row[h.index[k]] * h.weight[k];
+      }
+      out[x] = static_cast<unsigned char>(clamp(sum, 0.0f, 255.0f));
+    }
+  }
+  return output;
+}
+/** Pyramid of one channel, levels are built when first asked for */
+Pyramid::Pyramid(vector<vector<unsigned char>> base, int height, int width) : height(height), width(width) {
+  levels.emplace(make_pair(0, 0), std::move(base));
+}
+int Pyramid::halvings(int size, int outSize){
+  int count = 0;
+  while (size / 2 >= outSize){
+    size = (size + 1) / 2;
+    count++;
+  }
+  return count;
+}
+int Pyramid::halvedSize(int size, int halvings){
+  for (int i = 0; i < halvings; i++){
+    size = (size + 1) / 2;
+  }
+  return size;
+}
+const vector<vector<unsigned char>> &Pyramid::level(int xHalvings, int yHalvings){
+  auto found = levels.find(make_pair(xHalvings, yHalvings));
+  if (found != levels.end()){
+    return found->second;
+  }
+  //Rows first: halving the height on full width rows is the cheap pass, and the
+  //narrower levels of a larger output are then reused by a smaller one
+  vector<vector<unsigned char>> next;
+  if (xHalvings > 0){
+    next = halveWidth(level(xHalvings - 1, yHalvings), halvedSize(height, yHalvings), halvedSize(width, xHalvings - 1));
+  } else {
+    next = halveHeight(level(0, yHalvings - 1), halvedSize(height, yHalvings - 1), width);
+  }
+  //map keeps references to the other levels valid
+  return levels.emplace(make_pair(xHalvings, yHalvings), std::move(next)).first->second;
+}
+/**Downsample through the pyramid**/
+vector<vector<unsigned char>> scaleDownPyramid(Pyramid &pyramid, int outHeight, int outWidth){
+  TRACE_SCOPE("scale down pyramid");
+  int width = pyramid.width;
+  int height = pyramid.height;
+  int xHalvings = Pyramid::halvings(width, outWidth);
+  int yHalvings = Pyramid::halvings(height, outHeight);
+  const vector<vector<unsigned char>> &level = pyramid.level(xHalvings, yHalvings);
+  int levelWidth = Pyramid::halvedSize(width, xHalvings);
+  int levelHeight = Pyramid::halvedSize(height, yHalvings);
+  //Same geometry as the fixed kernel path, moved onto the level's pixel grid
+  bool stretch = (outWidth == 1920 || outWidth == 1280);
+  vector<double> xPositions = downsamplePositions(width, outWidth, stretch);
+  vector<double> yPositions = downsamplePositions(height, outHeight, stretch);
+  for (double &p : xPositions){
+    p = (p + 0.5) / (1 << xHalvings) - 0.5;
+  }
+  for (double &p : yPositions){
+    p = (p + 0.5) / (1 << yHalvings) - 0.5;
+  }
+  vector<vector<unsigned char>> output = resampleFractional(level, levelHeight, levelWidth, xPositions, yPositions,
+                                                            static_cast<double>(levelWidth) / outWidth, static_cast<double>(levelHeight) / outHeight);
+  if (resampleLog){
+    cout<<"Pyramid level "<<levelWidth<<"x"<<levelHeight<<", Down Sampled Red/Green/Blue Channel"<<endl;
+  }
+  return output;
+}
+vector<vector<unsigned char>> scaleDownPyramid(vector<vector<unsigned char>> input, int height, int width, int outHeight, int outWidth){
+  Pyramid pyramid(std::move(input), height, width);
+  return scaleDownPyramid(pyramid, outHeight, outWidth);
+}
+/**Upsample Using Bilinear Resizing**/
+vector<vector<unsigned char>> scaleUp(vector<vector<unsigned char>> input, int height, int width, int outHeight, int outWidth){
+  TRACE_SCOPE("scale up");
+  vector<vector<unsigned char>> output(outHeight, vector<unsigned char>(outWidth));
+  float xRatio = static_cast<float>(width-1) / (outWidth - 1);
+  float yRatio = static_cast<float>(height-1) / (outHeight - 1);
+
+    for (int y = 0; y < outHeight; y++) {
+        for (int x = 0; x < outWidth; x++) {
+          float x1 = floor(xRatio * x);
+          float y1 = floor(yRatio * y);
+          //Rounding can push the last column/row a hair past width - 1
+          float xh = min(ceil(xRatio * x), static_cast<float>(width - 1));
+          float yh = min(ceil(yRatio * y), static_cast<float>(height - 1));
+
+          float xWeight = (xRatio * x) - x1;
+          float yWeight = (yRatio * y) - y1;
+
+          unsigned char a = (input[y1][x1]);
+          unsigned char b = (input[y1][xh]);
+          unsigned char c = (input[yh][x1]);
+          unsigned char d = (input[yh][xh]);
+
+          float pixel = a * (1 - xWeight) * (1 - yWeight) + b * (xWeight) * (1 - yWeight) + c * (yWeight) * (1 - xWeight) + d * (xWeight) * (yWeight);
+
+          output[y][x] = static_cast<unsigned char>((pixel));
+        }
+    }
+    if (resampleLog){
+      cout<<"Up Sampled Red/Green/Blue Channel"<<endl;
+    }
+    return output;
+}
+/** Function to turn 2D back into readable 1D stream**/
+vector<unsigned char> to1D(vector<vector<unsigned char>> output2D, int height, int width){
+  TRACE_SCOPE("to1D");
+  vector<unsigned char> buf(width * height);
+  int index = 0;
+  for (int i = 0; i < height; i++){
+    for (int j = 0; j < width; j++){
+      buf[index] = static_cast<unsigned char>(output2D[i][j]);
+      index++;
+      //cout << "Current buf: " << static_cast<unsigned char>(output2D[i][j]) << "--------- j: " << j << " i: " << i << endl;
+    }
+  }
+  return buf;
+}
+/** Function to check for a supported resample: any up sampling, down sampling only to the O1 - O3 widths */
+bool canResample(int width, int outWidth){
+  return outWidth > width || (outWidth < width && (outWidth == 1920 || outWidth == 1280 || outWidth == 640));
+}
+/** Function to resample one channel to several sizes, sharing the blurred image or the pyramid between them */
+vector<vector<unsigned char>> resampleChannelSizes(const vector<vector<unsigned char>> &channel, int height, int width, const vector<pair<int, int>> &outSizes){
+  vector<vector<unsigned char>> outputs(outSizes.size());
+  //Built by the first down sampled size that needs them
+  unique_ptr<Pyramid> pyramid;
+  vector<vector<unsigned char>> blurred;
+  for (size_t i = 0; i < outSizes.size(); i++){
+    int outWidth = outSizes[i].first;
+    int outHeight = outSizes[i].second;
+    if (!canResample(width, outWidth)){
+      continue;
+    }
+    if (outWidth > width){
+      //Bilinear Resize
+      outputs[i] = to1D(scaleUp(channel, height, width, outHeight, outWidth), outHeight, outWidth);
+    } else if (pyramidDownsample){
+      if (!pyramid){
+        pyramid = make_unique<Pyramid>(channel, height, width);
+      }
+      outputs[i] = to1D(scaleDownPyramid(*pyramid, outHeight, outWidth), outHeight, outWidth);
+    } else {
+      //Gaussian Kernel Horizontal & Vertical, built once for every channel and frame
+      const int kernelSize = 5;
+      static const vector<vector<double>> kernel2D = create2DKernel(kernelSize);
+      if (blurred.empty()){
+        blurred = applyKernel(channel, kernel2D, kernelSize, height, width);
+      }
+      //Scale Down
+      vector<vector<unsigned char>> small = (outWidth == 640) ? scaleDownO3(blurred, height, width, outHeight, outWidth) : scaleDownO12(blurred, height, width, outHeight, outWidth);
+      //Turn back into stream
+      outputs[i] = to1D(small, outHeight, outWidth);
+    }
+  }
+  return outputs;
+}
+/** Function to resample one channel, the per-channel work of resampleImage */
+vector<unsigned char> resampleChannel(const vector<vector<unsigned char>> &channel, int height, int width, int outHeight, int outWidth){
+  return std::move(resampleChannelSizes(channel, height, width, {make_pair(outWidth, outHeight)})[0]);
+}
+/** Utility function to read image data */
+unsigned char *resampleImage(string imagePath, int width, int height, int outWidth, int outHeight) {
+  TRACE_SCOPE("resample");
+
+  /**
+   * The input RGB file is formatted as RRRR.....GGGG....BBBB.
+   * i.e the R values of all the pixels followed by the G values
+   * of all the pixels followed by the B values of all pixels.
+   * The file is memory mapped and each channel is read in place.
+   */
+  MappedRGBFile file(imagePath, width, height);
+
+  if (outWidth < width){
+    cout << "Time to DownSample"<<endl;
+    if (outWidth == 1920 || outWidth == 1280){
+      cout<<"O1 or O2 Selected"<<endl;
+    } else if (outWidth == 640){
+      cout<<"O3 Selected"<<endl;
+    } else {
+      cout << "How did you get here"<<endl;
+      return NULL;
+    }
+  } else if (outWidth == width){
+    cout<<"Something went wrong, you shouldn't be here"<<endl;
+    return NULL;
+  }
+  //Turn each channel to a 2D array and resample it
+  vector<unsigned char> channels[3];
+  for (int c = 0; c < 3; c++){
+    channels[c] = resampleChannel(to2D<unsigned char>(file.plane(c)), height, width, outHeight, outWidth);
+  }
+
+  //Finish
+  return transferInData(channels[0], channels[1], channels[2], outWidth, outHeight);
+}
+
+/** Function to read an image once and resample it to every size in outSizes, channels in parallel */
+vector<ResampledImage> resampleImageSizes(string imagePath, int width, int height, const vector<pair<int, int>> &outSizes){
+  TRACE_SCOPE("resample sizes");
+  MappedRGBFile file(imagePath, width, height);
+  vector<vector<unsigned char>> channels[3];
+  //Channels share nothing, so each gets a thread that does every size.
+  //The flag is only written when it is on, so concurrent calls with logging off never touch it
+  bool log = resampleLog;
+  if (log){
+    resampleLog = false;
+  }
+  vector<thread> workers;
+  for (int c = 0; c < 3; c++){
+    workers.emplace_back([&, c]() {
+      channels[c] = resampleChannelSizes(to2D<unsigned char>(file.plane(c)), height, width, outSizes);
+    });
+  }
+  for (thread &worker : workers){
+    worker.join();
+  }
+  if (log){
+    resampleLog = true;
+  }
+  vector<ResampledImage> images(outSizes.size());
+  for (size_t i = 0; i < outSizes.size(); i++){
+    images[i].width = outSizes[i].first;
+    images[i].height = outSizes[i].second;
+    for (int c = 0; c < 3; c++){
+      images[i].channels[c] = std::move(channels[c][i]);
+    }
+  }
+  return images;
+}
+/** Function to write a resampled image as a planar .rgb file */
+bool writeResampledImage(const string &path, const ResampledImage &image){
+  TRACE_SCOPE("write");
+  ofstream outputFile(path, ios::binary);
+  if (!outputFile.is_open()){
+    return false;
+  }
+  for (int c = 0; c < 3; c++){
+    outputFile.write(reinterpret_cast<const char *>(image.channels[c].data()), image.channels[c].size());
+  }
+  return outputFile.good();
+}
+
+void ReorderBuffer::put(SequenceFrame frame){
+  unique_lock<mutex> guard(lock);
+  //The frame the writer waits for is always inside the window, so this cannot deadlock
+  changed.wait(guard, [&]() { return frame.index < next + window; });
+  frames.emplace(frame.index, std::move(frame));
+  changed.notify_all();
+}
+SequenceFrame ReorderBuffer::take(){
+  unique_lock<mutex> guard(lock);
+  changed.wait(guard, [&]() { return frames.count(next) > 0; });
+  SequenceFrame frame = std::move(frames[next]);
+  frames.erase(next);
+  next++;
+  changed.notify_all();
+  return frame;
+}
+
+/** Function to print the mean and worst time between two stage boundaries over all frames */
+void printStageLatency(const string &stage, const vector<SequenceClock::duration> &times){
+  double total = 0;
+  double worst = 0;
+  for (SequenceClock::duration t : times){
+    double ms = chrono::duration<double, milli>(t).count();
+    total += ms;
+    worst = max(worst, ms);
+  }
+  ios state(nullptr);
+  state.copyfmt(cout);
+  cout << "  " << left << setw(16) << stage << right << fixed << setprecision(2)
+       << " mean " << setw(9) << total / times.size() << " ms   max " << setw(9) << worst << " ms" << endl;
+  cout.copyfmt(state);
+}
+
+/** Function to resample a raw frame sequence through the read / resample / write pipeline */
+bool resampleSequence(string inPath, int width, int height, int outWidth, int outHeight, string outPath, int threads){
+  MappedRGBFile file(inPath, width, height, true, true);
+  if (!canResample(width, outWidth)){
+    cerr << "Cannot resample " << width << "x" << height << " to " << outWidth << "x" << outHeight << endl;
+    return false;
+  }
+  ofstream outputFile(outPath, ios::binary);
+  if (!outputFile.is_open()){
+    return false;
+  }
+  if (threads <= 0){
+    threads = max(1u, thread::hardware_concurrency());
+  }
+  //Frames run in parallel, so the per channel messages would interleave; put the caller's setting back at the end
+  bool log = resampleLog;
+  if (log){
+    resampleLog = false;
+  }
+  int frameCount = file.frames;
+  cout << "Resampling " << frameCount << " frames " << width << "x" << height << " -> " << outWidth << "x" << outHeight
+       << " with " << threads << " worker" << (threads == 1 ? "" : "s") << endl;
+
+  //A few frames in each queue keep every stage busy without holding the whole sequence
+  BoundedQueue<SequenceFrame> toResample(threads);
+  ReorderBuffer toWrite(2 * threads);
+  SequenceClock::time_point start = SequenceClock::now();
+
+  //Read stage: copy each frame out of the mapping (this is where the file is paged in)
+  thread reader([&]() {
+    for (int i = 0; i < frameCount; i++){
+      TRACE_SCOPE("sequence read");
+      SequenceFrame frame;
+      frame.index = i;
+      frame.readStart = SequenceClock::now();
+      for (int c = 0; c < 3; c++){
+        frame.channels[c] = to2D<unsigned char>(file.plane(c, i));
+      }
+      frame.readEnd = SequenceClock::now();
+      toResample.push(std::move(frame));
+    }
+    toResample.close();
+  });
+
+  //Resample stage: frames in parallel
+  vector<thread> workers;
+  for (int w = 0; w < threads; w++){
+    workers.emplace_back([&]() {
+      SequenceFrame frame;
+      while (toResample.pop(frame)){
+        TRACE_SCOPE("sequence resample");
+        frame.resampleStart = SequenceClock::now();
+        for (int c = 0; c < 3; c++){
+          frame.resampled[c] = resampleChannel(frame.channels[c], height, width, outHeight, outWidth);
+          frame.channels[c] = vector<vector<unsigned char>>();
+        }
+        frame.resampleEnd = SequenceClock::now();
+        toWrite.put(std::move(frame));
+      }
+    });
+  }
+
+  //Write stage: in order, same planar layout as the input
+  vector<SequenceClock::duration> readTimes, queueTimes, resampleTimes, reorderTimes, writeTimes, totalTimes;
+  bool written = true;
+  for (int i = 0; i < frameCount; i++){
+    SequenceFrame frame = toWrite.take();
+    TRACE_SCOPE("sequence write");
+    frame.writeStart = SequenceClock::now();
+    for (int c = 0; c < 3; c++){
+      outputFile.write(reinterpret_cast<const char *>(frame.resampled[c].data()), frame.resampled[c].size());
+    }
+    written = written && outputFile.good();
+    frame.writeEnd = SequenceClock::now();
+    readTimes.push_back(frame.readEnd - frame.readStart);
+    queueTimes.push_back(frame.resampleStart - frame.readEnd);
+    resampleTimes.push_back(frame.resampleEnd - frame.resampleStart);
+    reorderTimes.push_back(frame.writeStart - frame.resampleEnd);
+    writeTimes.push_back(frame.writeEnd - frame.writeStart);
+    totalTimes.push_back(frame.writeEnd - frame.readStart);
+  }
+  reader.join();
+  for (thread &worker : workers){
+    worker.join();
+  }
+  outputFile.flush();
+  written = written && outputFile.good();
+  if (log){
+    resampleLog = true;
+  }
+
+  double seconds = chrono::duration<double>(SequenceClock::now() - start).count();
+  ios state(nullptr);
+  state.copyfmt(cout);
+  cout << frameCount << " frames in " << fixed << setprecision(2) << seconds << " s, " << frameCount / seconds << " fps sustained" << endl;
+  cout.copyfmt(state);
+  cout << "Per frame latency:" << endl;
+  printStageLatency("read", readTimes);
+  printStageLatency("wait for worker", queueTimes);
+  printStageLatency("resample", resampleTimes);
+  printStageLatency("wait for order", reorderTimes);
+  printStageLatency("write", writeTimes);
+  printStageLatency("end to end", totalTimes);
+  return written;
+}
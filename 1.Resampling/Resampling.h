@@ -0,0 +1,177 @@
+#pragma once
+/**
+ * GUI-free resampling core: Gaussian smoothing, down and up sampling of
+ * planar .rgb images. Linked by the wxWidgets front end (Main.cpp) and the
+ * command line front end (Cli.cpp).
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "../common/ImageCore.h"
+
+/** Utility function to read and resample image data, returns a malloc'd RGB buffer of outWidth x outHeight */
+unsigned char *resampleImage(std::string imagePath, int width, int height, int outWidth, int outHeight);
+//Output format name (O1, O2, O3) to its size, false if unknown
+bool outputFormatSize(std::string format, int &outWidth, int &outHeight);
+//Everything that decides the output of resampleImage, for ResultCache keys; bump the version when the output changes
+std::string resampleOperation(int width, int height, int outWidth, int outHeight);
+//Up sampling, or down sampling to the O1 - O3 widths
+bool canResample(int width, int outWidth);
+//Resample one channel to outWidth x outHeight, empty unless canResample
+std::vector<unsigned char> resampleChannel(const std::vector<std::vector<unsigned char>> &channel, int height, int width, int outHeight, int outWidth);
+//Same for several (outWidth, outHeight) sizes at once, one stream per size
+std::vector<std::vector<unsigned char>> resampleChannelSizes(const std::vector<std::vector<unsigned char>> &channel, int height, int width, const std::vector<std::pair<int, int>> &outSizes);
+
+/** One output of resampleImageSizes, planar; channels are empty if the size cannot be resampled */
+struct ResampledImage {
+  int width = 0;
+  int height = 0;
+  std::vector<unsigned char> channels[3];
+};
+//Read imagePath once and resample it to every (outWidth, outHeight) in outSizes
+std::vector<ResampledImage> resampleImageSizes(std::string imagePath, int width, int height, const std::vector<std::pair<int, int>> &outSizes);
+//Write a resampled image as a planar .rgb file, false if it cannot be written
+bool writeResampledImage(const std::string &path, const ResampledImage &image);
+//Per channel progress messages, turned off when frames run in parallel
+extern bool resampleLog;
+//Down sample through the Gaussian pyramid (default), false for the fixed 5x5 kernel
+extern bool pyramidDownsample;
+
+/**Downsampling Functions**/
+//Create 1D kernel
+std::vector<std::vector<double>> create2DKernel(int kernelSize);
+//Apply Kernel
+std::vector<std::vector<unsigned char>> applyKernel(std::vector<std::vector<unsigned char>> image2D, std::vector<std::vector<double>> kernel, int kernelSize, int height, int width);
+//ScaleDownO12
+std::vector<std::vector<unsigned char>> scaleDownO12(std::vector<std::vector<unsigned char>> input, int height, int width, int outHeight, int outWidth);
+//ScaleDownO3
+std::vector<std::vector<unsigned char>> scaleDownO3(std::vector<std::vector<unsigned char>> input, int height, int width, int outHeight, int outWidth);
+/**
+ * Pyramid Downsampling.
+ * Each axis is halved with the [1 3 3 1]/8 binomial kernel while it stays at
+ * least as large as the output, leaving a residual scale in [1, 2). One
+ * fractional pass then samples the output positions with a tent filter as
+ * wide as that residual scale, so every ratio gets a filter matched to it
+ * and the cost stays close to one pass over the input.
+ */
+//Halve the width, output (width + 1) / 2 columns
+std::vector<std::vector<unsigned char>> halveWidth(const std::vector<std::vector<unsigned char>> &input, int height, int width);
+//Halve the height, output (height + 1) / 2 rows
+std::vector<std::vector<unsigned char>> halveHeight(const std::vector<std::vector<unsigned char>> &input, int height, int width);
+//Source position (input pixel units) of every output pixel; stretch = the O1/O2 non linear mapping of scaleDownO12
+std::vector<double> downsamplePositions(int size, int outSize, bool stretch);
+//Tent filter a pyramid level at the given positions, scale = level pixels per output pixel
+std::vector<std::vector<unsigned char>> resampleFractional(const std::vector<std::vector<unsigned char>> &level, int height, int width, const std::vector<double> &xPositions,
+                                                           const std::vector<double> &yPositions, double xScale, double yScale);
+/** Pyramid levels of one channel, kept so that several output sizes share them */
+class Pyramid {
+ public:
+  Pyramid(std::vector<std::vector<unsigned char>> base, int height, int width);
+  //The input halved xHalvings times across and yHalvings times down, built on first use
+  const std::vector<std::vector<unsigned char>> &level(int xHalvings, int yHalvings);
+  //How many halvings keep size at least outSize
+  static int halvings(int size, int outSize);
+  //size after that many halvings
+  static int halvedSize(int size, int halvings);
+  int height;
+  int width;
+
+ private:
+  std::map<std::pair<int, int>, std::vector<std::vector<unsigned char>>> levels;
+};
+//Pyramid then fractional pass
+std::vector<std::vector<unsigned char>> scaleDownPyramid(Pyramid &pyramid, int outHeight, int outWidth);
+std::vector<std::vector<unsigned char>> scaleDownPyramid(std::vector<std::vector<unsigned char>> input, int height, int width, int outHeight, int outWidth);
+/**Upsample Using Bilinear Resizing**/
+std::vector<std::vector<unsigned char>> scaleUp(std::vector<std::vector<unsigned char>> input, int height, int width, int outHeight, int outWidth);
+//2D output to 1D stream
+std::vector<unsigned char> to1D(std::vector<std::vector<unsigned char>> output2D, int height, int width);
+
+/**
+ * Frame sequences.
+ * A raw sequence is planar .rgb frames back to back. resampleSequence runs
+ * read -> resample -> write as overlapped stages: one reader thread, a pool
+ * of resample workers and the writer on the calling thread, joined by
+ * bounded queues so memory stays a few frames deep. Workers finish out of
+ * order; a reorder buffer hands frames to the writer in index order.
+ */
+using SequenceClock = std::chrono::steady_clock;
+struct SequenceFrame {
+  int index = 0;
+  std::vector<std::vector<unsigned char>> channels[3];
+  std::vector<unsigned char> resampled[3];
+  //Stage boundaries, for the latency report
+  SequenceClock::time_point readStart, readEnd, resampleStart, resampleEnd, writeStart, writeEnd;
+};
+
+/** Bounded multi producer / multi consumer FIFO between two stages */
+template <typename T> class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+  //Blocks while full
+  void push(T item){
+    std::unique_lock<std::mutex> guard(lock);
+    notFull.wait(guard, [&]() { return items.size() < capacity; });
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+  }
+  //Blocks until an item is ready, false once closed and empty
+  bool pop(T &item){
+    std::unique_lock<std::mutex> guard(lock);
+    notEmpty.wait(guard, [&]() { return closed || !items.empty(); });
+    if (items.empty()){
+      return false;
+    }
+    item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+  //No more pushes, wakes every consumer
+  void close(){
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    notEmpty.notify_all();
+  }
+
+ private:
+  std::mutex lock;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+  std::deque<T> items;
+  size_t capacity;
+  bool closed = false;
+};
+
+/** Frames finished in any order, taken out in index order */
+class ReorderBuffer {
+ public:
+  //window = how far past the next frame out a frame may be put before put() blocks
+  explicit ReorderBuffer(int window) : window(window) {}
+  void put(SequenceFrame frame);
+  //Blocks until the next frame in order is ready
+  SequenceFrame take();
+
+ private:
+  std::mutex lock;
+  std::condition_variable changed;
+  std::map<int, SequenceFrame> frames;
+  int next = 0;
+  int window;
+};
+
+//Resample every frame of inPath into outPath (same planar layout), threads resample workers (0 = one per core).
+//Prints sustained fps and per-stage latency; false if outPath cannot be written
+bool resampleSequence(std::string inPath, int width, int height, int outWidth, int outHeight, std::string outPath, int threads);
@@ -0,0 +1,41 @@
+#include "ColorSegmentation.h"
+#include "../common/ResultCache.h"
+
+using namespace std;
+
+/**
+ * Command line front end: segment without a window and write the result
+ * as a planar .rgb file.
+ * ./Segment input.rgb hue1 hue2 output.rgb [width height]
+ * Results are reused from $IMAGE_CACHE_DIR when it is set.
+ */
+int main(int argc, char **argv) {
+  if (argc != 5 && argc != 7) {
+    cerr << "Usage: " << argv[0] << " input.rgb hue1 hue2 output.rgb [width height]" << endl;
+    return 1;
+  }
+  string imagePath = argv[1];
+  int hue1 = atoi(argv[2]);
+  int hue2 = atoi(argv[3]);
+  if (hue1 < 0 || hue2 > 360 || hue1 > hue2) {
+    cerr << "Hues should satisfy 0 <= hue1 <= hue2 <= 360. Exiting..." << endl;
+    return 1;
+  }
+  //All images of the assignment are 512x512
+  int width = (argc == 7) ? atoi(argv[5]) : 512;
+  int height = (argc == 7) ? atoi(argv[6]) : 512;
+  ResultCache cache;
+  string key = cache.key(imagePath, width, height, hueFilterOperation(width, height, hue1, hue2));
+  if (cache.copyTo(key, argv[4])) {
+    cout << "Served from the result cache" << endl;
+    return 0;
+  }
+  unsigned char *outData = hueFilterImage(imagePath, width, height, hue1, hue2);
+  if (!writePlanarRGB(argv[4], outData, width, height)) {
+    cerr << "Error Opening File for Writing" << endl;
+    return 1;
+  }
+  free(outData);
+  cache.storeFile(key, argv[4]);
+  return 0;
+}
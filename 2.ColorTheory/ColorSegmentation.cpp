@@ -0,0 +1,150 @@
+#include "ColorSegmentation.h"
+
+using namespace std;
+
+/** Function to describe a segmentation for the result cache */
+string hueFilterOperation(int width, int height, int hue1, int hue2){
+  return "hue filter v1 " + to_string(width) + "x" + to_string(height) + " " + to_string(hue1) + "-" + to_string(hue2);
+}
+
+/** Utility function to read and segment image data */
+unsigned char *hueFilterImage(string imagePath, int width, int height, int hue1, int hue2) {
+  TRACE_SCOPE("segment");
+
+  /**
+   * The input RGB file is formatted as RRRR.....GGGG....BBBB.
+   * i.e the R values of all the pixels followed by the G values
+   * of all the pixels followed by the B values of all pixels.
+   * The file is memory mapped and the channels are read in place.
+   */
+  MappedRGBFile file(imagePath, width, height);
+  const unsigned char *Rbuf = file.red().data;
+  const unsigned char *Gbuf = file.green().data;
+  const unsigned char *Bbuf = file.blue().data;
+
+  //Convert Red, Green, and Blue stream to HSV
+  // Create and populate RGB buffers
+  vector<float> Hbuf(width * height);
+  vector<float> Sbuf(width * height);
+  vector<float> Vbuf(width * height);
+
+  {
+    TRACE_SCOPE("rgb to hsv");
+    for (int i=0; i < width*height; i++){
+      //Hue
+      float h;
+      //Saturation
+      float s;
+      //Value (Brightness)
+      float v;
+
+      float redVal = static_cast<float>(Rbuf[i])/255.0;
+      float greenVal = static_cast<float>(Gbuf[i])/255.0;
+      float blueVal = static_cast<float>(Bbuf[i])/255.0;
+
+      float Cmax = max(redVal, max(greenVal, blueVal));
+      float Cmin = min(redVal, min(greenVal, blueVal));
+
+      float delta = Cmax - Cmin;
+
+      if (Cmax == Cmin){
+        h = 0;
+      } else if (Cmax == redVal){
+        h = (greenVal-blueVal)/delta;
+      } else if (Cmax == greenVal){
+        h = ((blueVal-redVal)/delta + 2.0);
+      } else if (Cmax == blueVal){
+        h = ((redVal-greenVal)/delta + 4.0);
+      }
+      h *= 60.0f;
+      if ( h < 0){
+        h += 360;
+      }
+      if (Cmax == 0){
+        s = 0.0;
+      } else {
+        s = delta/Cmax;
+      }
+      v = Cmax;
+      
+      //cout << "Part 1 : " << h << endl;
+      Hbuf[i] = h;
+      Sbuf[i] = s;
+      Vbuf[i] = v;
+    }
+  }
+  //Loop through stream and see if between hue1 and hue2
+  //If within --> keep color (do nothing)
+  //If not within --> make grey (saturation = 0)
+  {
+    TRACE_SCOPE("hue threshold");
+    for (int i=0; i < width*height; i++){
+      //MAYBE CHANGE TO INT
+      int h =(Hbuf[i]); 
+      if ((h < hue1 || h > hue2)){
+        //cout << Hbuf[i] << endl;
+        Sbuf[i] = 0;
+        //Vbuf[i] *= 0.1;
+      }
+    }
+  }
+  vector<unsigned char> newRed(width * height);
+  vector<unsigned char> newGreen(width * height);
+  vector<unsigned char> newBlue(width * height);
+
+  //Turn back into RGB
+  {
+    TRACE_SCOPE("hsv to rgb");
+    for (int i=0; i < width*height; i++){
+      if (Sbuf[i] == 0){
+        newRed[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+        newGreen[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+        newBlue[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+      } else {
+        float hp = Hbuf[i]/60;
+        int hf = floor(hp);
+        float f = hp - hf;
+
+        float p = Vbuf[i]*(1 - Sbuf[i]);
+        float q = Vbuf[i]*(1 - Sbuf[i] * f);
+        float t = Vbuf[i]*(1 - Sbuf[i] * (1 - f));
+
+        switch (hf) {
+          case 0:
+            newRed[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+            newGreen[i] = static_cast<unsigned char> (static_cast<int>((t)*255));
+            newBlue[i] = static_cast<unsigned char> (static_cast<int>((p)*255));
+            break;
+          case 1:
+            newRed[i] = static_cast<unsigned char> (static_cast<int>((q)*255));
+            newGreen[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+            newBlue[i] = static_cast<unsigned char> (static_cast<int>((p)*255));
+            break;
+          case 2:
+            newRed[i] = static_cast<unsigned char> (static_cast<int>((p)*255));
+            newGreen[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+            newBlue[i] = static_cast<unsigned char> (static_cast<int>((t)*255));
+            break;
+          case 3:
+            newRed[i] = static_cast<unsigned char> (static_cast<int>((p)*255));
+            newGreen[i] = static_cast<unsigned char> (static_cast<int>((q)*255));
+            newBlue[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+            break;
+          case 4:
+            newRed[i] = static_cast<unsigned char> (static_cast<int>((t)*255));
+            newGreen[i] = static_cast<unsigned char> (static_cast<int>((p)*255));
+            newBlue[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+            break;
+           default:
+            newRed[i] = static_cast<unsigned char> (static_cast<int>((Vbuf[i])*255));
+            newGreen[i] = static_cast<unsigned char> (static_cast<int>((p)*255));
+            newBlue[i] = static_cast<unsigned char> (static_cast<int>((q)*255));
+            break;
+        }
+      }
+    }
+  }
+
+  //Finish
+  return transferInData(newRed, newGreen, newBlue, width, height);
+}
@@ -0,0 +1,18 @@
+#pragma once
+/**
+ * GUI-free hue segmentation core: RGB -> HSV, desaturate every pixel whose
+ * hue is outside [hue1, hue2], HSV -> RGB. Linked by the wxWidgets front
+ * end (Main.cpp) and the command line front end (Cli.cpp).
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include "../common/ImageCore.h"
+
+/** Utility function to read and segment image data, returns a malloc'd RGB buffer */
+unsigned char *hueFilterImage(std::string imagePath, int width, int height, int hue1, int hue2);
+//Everything that decides the output of hueFilterImage, for ResultCache keys; bump the version when the output changes
+std::string hueFilterOperation(int width, int height, int hue1, int hue2);
@@ -0,0 +1,24 @@
+#include "Compression.h"
+
+using namespace std;
+
+/**
+ * Command line front end: the headless modes without wxWidgets.
+ * Same arguments as MyImageApplication, minus the windowed n / -1 / -2 / -3
+ * modes (use --reconstruct and --export for those).
+ */
+int main(int argc, char **argv) {
+  vector<string> args = parseOptions(vector<string>(argv, argv + argc));
+  runHeadless(args);
+  cerr << "Usage: " << args[0] << " image.rgb --reconstruct n prefix [haar|53|97]" << endl
+       << "       " << args[0] << " image.rgb --export prefix [-1|-2] [y4m|rgb]" << endl
+       << "       " << args[0] << " image.rgb --encode out.cmp [quality] [dct|dwt] [haar|53|97]" << endl
+       << "       " << args[0] << " in.cmp --decode out.rgb" << endl
+       << "       " << args[0] << " image.rgb --embed out.spt [haar|53|97]" << endl
+       << "       " << args[0] << " in.spt --truncate bytes out.rgb" << endl
+       << "       " << args[0] << " image.rgb --stream-dwt out.dwt [haar|53|97]" << endl
+       << "       " << args[0] << " image.rgb --accuracy [haar|53|97]" << endl
+       << "       " << args[0] << " --rd out.csv [n|-1|-2] image1.rgb [image2.rgb ...]" << endl
+       << "Options: --size WxH --levels L --chroma rgb|444|422|420 --precision double|float|fixed32|fixed16 --select position|channel|joint" << endl;
+  return 1;
+}
@@ -0,0 +1,2829 @@
+#include "Compression.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+vector<vector<double>> cosTableU;
+vector<vector<double>> cosTableV;
+Wavelet dwtWavelet = HAAR;
+//DWT decomposition levels, -1 = recurse until a side reaches 1
+int dwtLevels = -1;
+//Image size from --size, 0 = square image inferred from the file size
+int imageWidthOption = 0;
+int imageHeightOption = 0;
+ChromaFormat chromaFormat = CHROMA_RGB;
+//Sample type of the viewer and --rd pipeline, the codecs always use double
+Precision transformPrecision = PRECISION_FLOAT;
+CoeffSelection coeffSelection = SELECT_POSITION;
+bool compressionLog = true;
+
+/** Definitions */
+
+/** Function to map a wavelet argument (haar, 53, 97) to its filter, exits on anything else */
+Wavelet parseWavelet(const string &name){
+  if (name == "haar"){
+    return HAAR;
+  } else if (name == "53"){
+    return CDF53;
+  } else if (name == "97"){
+    return CDF97;
+  }
+  cerr << "Wavelet " << name << " is not haar, 53, or 97. Exiting..." << endl;
+  exit(1);
+}
+
+/**
+ * Options that may appear anywhere: --size WIDTHxHEIGHT, --levels L, --chroma rgb|444|422|420,
+ * --precision double|float|fixed32|fixed16, --select position|channel|joint.
+ * They set the globals above, the remaining arguments are returned in order.
+ */
+vector<string> parseOptions(const vector<string> &argv){
+  int argc = argv.size();
+  vector<string> args;
+  for (int i = 0; i < argc; i++){
+    string arg = argv[i];
+    if (arg == "--size" && i + 1 < argc){
+      string size = argv[++i];
+      if (sscanf(size.c_str(), "%dx%d", &imageWidthOption, &imageHeightOption) != 2 || imageWidthOption <= 0 || imageHeightOption <= 0){
+        cerr << "--size should look like 1920x1080. Exiting..." << endl;
+        exit(1);
+      }
+    } else if (arg == "--levels" && i + 1 < argc){
+      dwtLevels = atoi(argv[++i].c_str());
+    } else if (arg == "--precision" && i + 1 < argc){
+      string precision = argv[++i];
+      if (precision == "double"){
+        transformPrecision = PRECISION_DOUBLE;
+      } else if (precision == "float"){
+        transformPrecision = PRECISION_FLOAT;
+      } else if (precision == "fixed32"){
+        transformPrecision = PRECISION_FIXED32;
+      } else if (precision == "fixed16"){
+        transformPrecision = PRECISION_FIXED16;
+      } else {
+        cerr << "--precision should be double, float, fixed32 or fixed16. Exiting..." << endl;
+        exit(1);
+      }
+    } else if (arg == "--select" && i + 1 < argc){
+      string selection = argv[++i];
+      if (selection == "position"){
+        coeffSelection = SELECT_POSITION;
+      } else if (selection == "channel"){
+        coeffSelection = SELECT_CHANNEL;
+      } else if (selection == "joint"){
+        coeffSelection = SELECT_JOINT;
+      } else {
+        cerr << "--select should be position, channel or joint. Exiting..." << endl;
+        exit(1);
+      }
+    } else if (arg == "--chroma" && i + 1 < argc){
+      string format = argv[++i];
+      if (format == "444"){
+        chromaFormat = CHROMA_444;
+      } else if (format == "422"){
+        chromaFormat = CHROMA_422;
+      } else if (format == "420"){
+        chromaFormat = CHROMA_420;
+      } else if (format == "rgb"){
+        chromaFormat = CHROMA_RGB;
+      } else {
+        cerr << "--chroma should be rgb, 444, 422 or 420. Exiting..." << endl;
+        exit(1);
+      }
+    } else {
+      args.push_back(arg);
+    }
+  }
+  return args;
+}
+
+/**
+ * Headless modes, shared by the GUI and command line front ends.
+ * Runs the mode named by args (after parseOptions) and exits; returns when
+ * args name none of them.
+ */
+void runHeadless(const vector<string> &args){
+  int argc = args.size();
+  //Every mode prints its own summary
+  bool log = compressionLog;
+  compressionLog = false;
+  //./MyImageApplication image.rgb --encode out.cmp [quality] [dct|dwt] [haar|53|97]
+  //./MyImageApplication in.cmp --decode out.rgb
+  if (argc >= 4 && args[2] == "--encode"){
+    int quality = (argc > 4) ? atoi(args[4].c_str()) : 50;
+    bool isDCT = !(argc > 5 && args[5] == "dwt");
+    if (argc > 6){
+      dwtWavelet = parseWavelet(args[6]);
+    }
+    cosTableU = outputCosineTableU(8,8);
+    cosTableV = outputCosineTableV(8,8);
+    runEncode(args[1], args[3], quality, isDCT);
+    exit(0);
+  }
+  //./MyImageApplication image.rgb --embed out.spt [haar|53|97]
+  //./MyImageApplication in.spt --truncate bytes out.rgb
+  if (argc >= 4 && args[2] == "--embed"){
+    if (argc > 4){
+      dwtWavelet = parseWavelet(args[4]);
+    }
+    runEmbed(args[1], args[3]);
+    exit(0);
+  }
+  if (argc == 5 && args[2] == "--truncate"){
+    runTruncate(args[1], atol(args[3].c_str()), args[4]);
+    exit(0);
+  }
+  //./MyImageApplication image.rgb --stream-dwt out.dwt [haar|53|97]
+  if ((argc == 4 || argc == 5) && args[2] == "--stream-dwt"){
+    if (argc == 5){
+      dwtWavelet = parseWavelet(args[4]);
+    }
+    runStreamDWT(args[1], args[3]);
+    exit(0);
+  }
+  //./MyImageApplication image.rgb --accuracy [haar|53|97]
+  if ((argc == 3 || argc == 4) && args[2] == "--accuracy"){
+    if (argc == 4){
+      dwtWavelet = parseWavelet(args[3]);
+    }
+    runAccuracy(args[1]);
+    exit(0);
+  }
+  //./MyImageApplication image.rgb --export prefix [-1|-2] [y4m|rgb]
+  if ((argc >= 4 && argc <= 6) && args[2] == "--export"){
+    string mode = (argc > 4) ? args[4] : "-1";
+    if (mode != "-1" && mode != "-2"){
+      cerr << "--export plays progressive part -1 or -2. Exiting..." << endl;
+      exit(1);
+    }
+    cosTableU = outputCosineTableU(8,8);
+    cosTableV = outputCosineTableV(8,8);
+    runExport(args[1], args[3], mode, !(argc > 5 && args[5] == "rgb"));
+    exit(0);
+  }
+  //./MyImageApplication image.rgb --reconstruct n prefix [haar|53|97]
+  if ((argc == 5 || argc == 6) && args[2] == "--reconstruct"){
+    if (argc == 6){
+      dwtWavelet = parseWavelet(args[5]);
+    }
+    char *end = nullptr;
+    long n = strtol(args[3].c_str(), &end, 10);
+    if (args[3].empty() || *end != '\0' || n <= 0 || n > INT32_MAX){
+      cerr << "--reconstruct n should be a positive number of coefficients per channel, not " << args[3] << endl;
+      exit(1);
+    }
+    cosTableU = outputCosineTableU(8,8);
+    cosTableV = outputCosineTableV(8,8);
+    runReconstruct(args[1], static_cast<int>(n), args[4]);
+    exit(0);
+  }
+  //./MyImageApplication --rd out.csv [n|-1|-2] image1.rgb [image2.rgb ...]
+  if (argc >= 5 && args[1] == "--rd"){
+    cosTableU = outputCosineTableU(8,8);
+    cosTableV = outputCosineTableV(8,8);
+    vector<string> imagePaths(args.begin() + 4, args.end());
+    runRateDistortion(args[2], args[3], imagePaths);
+    exit(0);
+  }
+  if (argc == 4 && args[2] == "--decode"){
+    cosTableU = outputCosineTableU(8,8);
+    cosTableV = outputCosineTableV(8,8);
+    runDecode(args[1], args[3]);
+    exit(0);
+  }
+  compressionLog = log;
+}
+
+FrameQueue::~FrameQueue(){
+  for (DecodedFrame &frame : frames){
+    free(frame.data);
+  }
+  for (unsigned char *data : spare){
+    free(data);
+  }
+}
+bool FrameQueue::push(DecodedFrame frame){
+  unique_lock<mutex> guard(lock);
+  notFull.wait(guard, [&]() { return cancelled || frames.size() < capacity; });
+  if (cancelled){
+    free(frame.data);
+    return false;
+  }
+  frames.push_back(frame);
+  TRACE_COUNTER("frame queue depth", frames.size());
+  notEmpty.notify_one();
+  return true;
+}
+bool FrameQueue::tryPop(DecodedFrame &frame){
+  lock_guard<mutex> guard(lock);
+  if (frames.empty()){
+    return false;
+  }
+  frame = frames.front();
+  frames.pop_front();
+  notFull.notify_one();
+  return true;
+}
+bool FrameQueue::pop(DecodedFrame &frame){
+  unique_lock<mutex> guard(lock);
+  notEmpty.wait(guard, [&]() { return finished || !frames.empty(); });
+  if (frames.empty()){
+    return false;
+  }
+  frame = frames.front();
+  frames.pop_front();
+  notFull.notify_one();
+  return true;
+}
+void FrameQueue::finish(){
+  lock_guard<mutex> guard(lock);
+  finished = true;
+  notEmpty.notify_all();
+}
+void FrameQueue::cancel(){
+  lock_guard<mutex> guard(lock);
+  cancelled = true;
+  notFull.notify_all();
+}
+bool FrameQueue::drained(){
+  lock_guard<mutex> guard(lock);
+  return finished && frames.empty();
+}
+unsigned char *FrameQueue::buffer(size_t bytes){
+  {
+    lock_guard<mutex> guard(lock);
+    if (!spare.empty()){
+      unsigned char *data = spare.back();
+      spare.pop_back();
+      return data;
+    }
+  }
+  return (unsigned char *)malloc(bytes);
+}
+void FrameQueue::recycle(unsigned char *data){
+  lock_guard<mutex> guard(lock);
+  spare.push_back(data);
+}
+/** Function to encode an image into the DCT or DWT planes of coeffs */
+void encodeCoefficients(const ImagePlanes &image, ImageCoefficients &coeffs, bool isDCT){
+  TRACE_SCOPE("encode");
+  coeffs.width = image.width;
+  coeffs.height = image.height;
+  coeffs.chroma = chromaFormat;
+  coeffs.precision = transformPrecision;
+  //Chroma planes of a subsampled image are smaller, so they cost less to transform
+  ImagePlanes planes = (chromaFormat == CHROMA_RGB) ? image : toYCbCr(image, chromaFormat);
+  switch (coeffs.precision){
+    case PRECISION_DOUBLE: encodePlanes(planes, coeffs.doubles, isDCT); break;
+    case PRECISION_FLOAT: encodePlanes(planes, coeffs.floats, isDCT); break;
+    case PRECISION_FIXED32: encodePlanes(planes, coeffs.fixed32, isDCT); break;
+    case PRECISION_FIXED16: encodePlanes(planes, coeffs.fixed16, isDCT); break;
+  }
+  if (compressionLog){
+    cout << (isDCT ? "Finished DCT Encoding" : "Finished DWT Encoding") << endl;
+  }
+}
+template <typename T> void encodePlanes(const ImagePlanes &planes, CoefficientPlanes<T> &out, bool isDCT){
+  const vector<vector<double>> *channels[3] = {&planes.red, &planes.green, &planes.blue};
+  vector<vector<T>> *DCTPlanes[3] = {&out.DCTRed, &out.DCTGreen, &out.DCTBlue};
+  vector<vector<T>> *DWTPlanes[3] = {&out.DWTRed, &out.DWTGreen, &out.DWTBlue};
+  for (int c = 0; c < 3; c++){
+    int planeWidth;
+    int planeHeight;
+    planeSize(planes.chroma, c, planes.width, planes.height, planeWidth, planeHeight);
+    vector<vector<T>> samples = toSamples<T>(*channels[c]);
+    if (isDCT){
+      *DCTPlanes[c] = dctPlane(samples, planeHeight, planeWidth);
+    } else {
+      // DWT, lifting handles any size with symmetric extension
+      *DWTPlanes[c] = move(samples);
+      outputDWT(*DWTPlanes[c], planeHeight, planeWidth, dwtWavelet, dwtLevels);
+    }
+  }
+}
+
+/** Function to DCT a plane in 8x8 blocks, edge padded to multiples of 8 */
+template <typename T> vector<vector<T>> dctPlane(const vector<vector<T>> &plane, int height, int width){
+  TRACE_SCOPE("dct");
+  int paddedWidth = (width + 7) / 8 * 8;
+  int paddedHeight = (height + 7) / 8 * 8;
+  // Blocks at the right/bottom edge see replicated edge pixels
+  vector<vector<T>> padded = padPlane(plane, paddedHeight, paddedWidth);
+  vector<vector<T>> coeffPlane(paddedHeight, vector<T>(paddedWidth));
+  const auto &cosTable = cosineTable<T>();
+  for (int i = 0; i < paddedHeight; i += 8) {
+      for (int j = 0; j < paddedWidth; j += 8) {
+          vector<vector<T>> chunk = outputDCTBlock(padded, j, i, cosTable, cosTable);
+          for (int y = 0; y < 8; y++) {
+              copy(chunk[y].begin(), chunk[y].end(), coeffPlane[i + y].begin() + j);
+          }
+      }
+  }
+  return coeffPlane;
+}
+
+/** Function to get the image size, from --size or a square image that fills the file */
+void imageDimensions(string imagePath, int &width, int &height){
+  if (imageWidthOption > 0){
+    width = imageWidthOption;
+    height = imageHeightOption;
+    return;
+  }
+  error_code ec;
+  uintmax_t fileSize = fs::file_size(imagePath, ec);
+  int side = ec ? 0 : static_cast<int>(lround(sqrt(fileSize / 3.0)));
+  if (side == 0 || static_cast<uintmax_t>(side) * side * 3 != fileSize){
+    cerr << "Cannot infer the size of " << imagePath << ", pass --size WIDTHxHEIGHT" << endl;
+    exit(1);
+  }
+  width = side;
+  height = side;
+}
+
+/** Function to read the planar .rgb file into three planes */
+ImagePlanes loadImage2D(string imagePath, int width, int height){
+  TRACE_SCOPE("load");
+  /**
+   * The input RGB file is formatted as RRRR.....GGGG....BBBB.
+   * The mapped file hands out each channel in place, so to2D is the
+   * only pass over the pixels.
+   */
+  MappedRGBFile file(imagePath, width, height);
+  ImagePlanes image;
+  image.width = width;
+  image.height = height;
+  image.red = to2D<double>(file.red());
+  image.green = to2D<double>(file.green());
+  image.blue = to2D<double>(file.blue());
+  return image;
+}
+
+/** Function to pad a plane by repeating its last row and column */
+template <typename T> vector<vector<T>> padPlane(const vector<vector<T>> &plane, int paddedHeight, int paddedWidth){
+  int height = plane.size();
+  int width = plane[0].size();
+  vector<vector<T>> padded(paddedHeight, vector<T>(paddedWidth));
+  for (int i = 0; i < paddedHeight; i++){
+    const vector<T> &row = plane[min(i, height - 1)];
+    copy(row.begin(), row.end(), padded[i].begin());
+    fill(padded[i].begin() + width, padded[i].end(), row[width - 1]);
+  }
+  return padded;
+}
+/** Function to keep only the top-left height x width of a plane */
+template <typename T> vector<vector<T>> cropPlane(const vector<vector<T>> &plane, int height, int width){
+  vector<vector<T>> cropped(height);
+  for (int i = 0; i < height; i++){
+    cropped[i].assign(plane[i].begin(), plane[i].begin() + width);
+  }
+  return cropped;
+}
+
+/** Function to convert a plane to the sample type T */
+template <typename T> vector<vector<T>> toSamples(const vector<vector<double>> &plane){
+  vector<vector<T>> out(plane.size());
+  for (size_t i = 0; i < plane.size(); i++){
+    out[i].resize(plane[i].size());
+    transform(plane[i].begin(), plane[i].end(), out[i].begin(), SampleTraits<T>::fromDouble);
+  }
+  return out;
+}
+/** Function to convert a plane of T back to double, out keeps its rows when the size matches */
+template <typename T> void fromSamples(const vector<vector<T>> &plane, vector<vector<double>> &out){
+  out.resize(plane.size());
+  for (size_t i = 0; i < plane.size(); i++){
+    out[i].resize(plane[i].size());
+    transform(plane[i].begin(), plane[i].end(), out[i].begin(), [](T v) { return SampleTraits<T>::toDouble(v); });
+  }
+}
+
+/**
+ * YCbCr front end (JFIF equations).
+ * The color transform is 16.16 fixed point like libjpeg: integer multiplies
+ * and a shift per sample. 4:2:2 halves the chroma width, 4:2:0 both sides,
+ * so chroma costs a quarter of the transform work at 4:2:0.
+ **/
+const int YCC_SHIFT = 16;
+const int YCC_HALF = 1 << (YCC_SHIFT - 1);
+const int YCC_CHROMA_OFFSET = 128 << YCC_SHIFT;
+//One pixel of the forward transform
+inline void rgbToYCbCr(int r, int g, int b, int &y, int &cb, int &cr){
+  y = (19595 * r + 38470 * g + 7471 * b + YCC_HALF) >> YCC_SHIFT;
+  cb = (-11059 * r - 21709 * g + 32768 * b + YCC_CHROMA_OFFSET + YCC_HALF - 1) >> YCC_SHIFT;
+  cr = (32768 * r - 27439 * g - 5329 * b + YCC_CHROMA_OFFSET + YCC_HALF - 1) >> YCC_SHIFT;
+}
+
+/** Function to get the size of one channel after chroma subsampling */
+void planeSize(ChromaFormat format, int channel, int width, int height, int &planeWidth, int &planeHeight){
+  planeWidth = width;
+  planeHeight = height;
+  if (channel > 0 && (format == CHROMA_422 || format == CHROMA_420)){
+    planeWidth = (width + 1) / 2;
+  }
+  if (channel > 0 && format == CHROMA_420){
+    planeHeight = (height + 1) / 2;
+  }
+}
+
+/** Function to convert RGB planes to Y, Cb, Cr and decimate the chroma */
+ImagePlanes toYCbCr(const ImagePlanes &image, ChromaFormat format){
+  TRACE_SCOPE("rgb to ycbcr");
+  int width = image.width;
+  int height = image.height;
+  ImagePlanes out;
+  out.width = width;
+  out.height = height;
+  out.chroma = format;
+  out.red.assign(height, vector<double>(width));
+  out.green.assign(height, vector<double>(width));
+  out.blue.assign(height, vector<double>(width));
+  for (int i = 0; i < height; i++){
+    for (int j = 0; j < width; j++){
+      int y;
+      int cb;
+      int cr;
+      rgbToYCbCr(static_cast<int>(image.red[i][j]), static_cast<int>(image.green[i][j]), static_cast<int>(image.blue[i][j]), y, cb, cr);
+      out.red[i][j] = y;
+      out.green[i][j] = cb;
+      out.blue[i][j] = cr;
+    }
+  }
+  int factorX = (format == CHROMA_422 || format == CHROMA_420) ? 2 : 1;
+  int factorY = (format == CHROMA_420) ? 2 : 1;
+  if (factorX > 1 || factorY > 1){
+    out.green = downsamplePlane(out.green, factorY, factorX);
+    out.blue = downsamplePlane(out.blue, factorY, factorX);
+  }
+  return out;
+}
+
+/** Function to upsample Cb/Cr back to full size and convert Y, Cb, Cr to RGB in place */
+void toRGB(ImagePlanes &image){
+  TRACE_SCOPE("ycbcr to rgb");
+  int width = image.width;
+  int height = image.height;
+  int factorX = (image.chroma == CHROMA_422 || image.chroma == CHROMA_420) ? 2 : 1;
+  int factorY = (image.chroma == CHROMA_420) ? 2 : 1;
+  if (factorX > 1 || factorY > 1){
+    image.green = upsamplePlane(image.green, height, width, factorY, factorX);
+    image.blue = upsamplePlane(image.blue, height, width, factorY, factorX);
+  }
+  for (int i = 0; i < height; i++){
+    for (int j = 0; j < width; j++){
+      int y = static_cast<int>(lround(image.red[i][j]));
+      int cb = static_cast<int>(lround(image.green[i][j])) - 128;
+      int cr = static_cast<int>(lround(image.blue[i][j])) - 128;
+      image.red[i][j] = clamp(y + ((91881 * cr + YCC_HALF) >> YCC_SHIFT), 0, 255);
+      image.green[i][j] = clamp(y + ((-22554 * cb - 46802 * cr + YCC_HALF) >> YCC_SHIFT), 0, 255);
+      image.blue[i][j] = clamp(y + ((116130 * cb + YCC_HALF) >> YCC_SHIFT), 0, 255);
+    }
+  }
+  image.chroma = CHROMA_RGB;
+}
+
+/** Function to average factorY x factorX cells, odd edges reuse the last row/column */
+vector<vector<double>> downsamplePlane(const vector<vector<double>> &plane, int factorY, int factorX){
+  int height = plane.size();
+  int width = plane[0].size();
+  int outHeight = (height + factorY - 1) / factorY;
+  int outWidth = (width + factorX - 1) / factorX;
+  vector<vector<double>> out(outHeight, vector<double>(outWidth));
+  double scale = 1.0 / (factorY * factorX);
+  for (int i = 0; i < outHeight; i++){
+    for (int j = 0; j < outWidth; j++){
+      double sum = 0.0;
+      for (int y = 0; y < factorY; y++){
+        const vector<double> &row = plane[min(i * factorY + y, height - 1)];
+        for (int x = 0; x < factorX; x++){
+          sum += row[min(j * factorX + x, width - 1)];
+        }
+      }
+      out[i][j] = sum * scale;
+    }
+  }
+  return out;
+}
+
+/** Function to upsample by 2 with a 3/4, 1/4 triangle filter (libjpeg "fancy" upsampling) */
+vector<vector<double>> upsamplePlane(const vector<vector<double>> &plane, int height, int width, int factorY, int factorX){
+  int inHeight = plane.size();
+  int inWidth = plane[0].size();
+  //Horizontal
+  vector<vector<double>> wide(inHeight, vector<double>(width));
+  for (int i = 0; i < inHeight; i++){
+    const vector<double> &row = plane[i];
+    for (int j = 0; j < width; j++){
+      if (factorX == 1){
+        wide[i][j] = row[j];
+        continue;
+      }
+      int k = j / 2;
+      int neighbour = (j % 2 == 0) ? max(k - 1, 0) : min(k + 1, inWidth - 1);
+      wide[i][j] = 0.75 * row[k] + 0.25 * row[neighbour];
+    }
+  }
+  if (factorY == 1){
+    return wide;
+  }
+  //Vertical
+  vector<vector<double>> out(height, vector<double>(width));
+  for (int i = 0; i < height; i++){
+    int k = i / 2;
+    int neighbour = (i % 2 == 0) ? max(k - 1, 0) : min(k + 1, inHeight - 1);
+    for (int j = 0; j < width; j++){
+      out[i][j] = 0.75 * wide[k][j] + 0.25 * wide[neighbour][j];
+    }
+  }
+  return out;
+}
+
+/** Function to turn 2D back into readable 1D stream and unnormalize rgb value**/
+vector<unsigned char> to1D(const vector<vector<double>> &output2D, int height, int width){
+  TRACE_SCOPE("to1D");
+  vector<unsigned char> buf(width * height);
+  int index = 0;
+  double test;
+  unsigned char test2;
+  for (int i = 0; i < height; i++){
+    for (int j = 0; j < width; j++){
+      buf[index] = static_cast<unsigned char>((output2D[i][j]));
+      index++;
+    }
+  }
+  return buf;
+}
+/** Function to interleave RGB planes into a malloc'd buffer, the conversion of to1D without its copies */
+unsigned char *toInterleaved(const ImagePlanes &image, unsigned char *rgb){
+  TRACE_SCOPE("interleave");
+  if (rgb == nullptr){
+    rgb = (unsigned char *)malloc(static_cast<size_t>(image.width) * image.height * 3);
+  }
+  unsigned char *out = rgb;
+  for (int i = 0; i < image.height; i++){
+    const double *red = image.red[i].data();
+    const double *green = image.green[i].data();
+    const double *blue = image.blue[i].data();
+    for (int j = 0; j < image.width; j++){
+      *out++ = static_cast<unsigned char>(red[j]);
+      *out++ = static_cast<unsigned char>(green[j]);
+      *out++ = static_cast<unsigned char>(blue[j]);
+    }
+  }
+  return rgb;
+}
+
+template <typename T> vector<vector<T>> &DecodeArena::plane(int height, int width){
+  Pool<T> &p = pool<T>();
+  if (p.used == p.planes.size()){
+    p.planes.emplace_back();
+  }
+  vector<vector<T>> &out = p.planes[p.used++];
+  //Same shape as last step: resize and assign stay within capacity
+  out.resize(height);
+  for (vector<T> &row : out){
+    row.assign(width, T(0));
+  }
+  return out;
+}
+void DecodeArena::reset(){
+  apply([](auto &...p) { ((p.used = 0), ...); }, pools);
+}
+/**Function to output 8x8 DCT block**/
+template <typename T> vector<vector<T>> outputDCTBlock(const vector<vector<T>> &ogBlock, int offsetX, int offsetY, const vector<vector<typename SampleTraits<T>::Coef>> &cosTableU, const vector<vector<typename SampleTraits<T>::Coef>> &cosTableV) {
+    using S = SampleTraits<T>;
+    vector<vector<T>> block(8, vector<T>(8));
+    const typename S::Coef quarter = S::coef(0.25);
+    const typename S::Coef invSqrt2 = S::coef(1.0 / (sqrt(2.0)));
+    const typename S::Coef one = S::coef(1.0);
+    // Do the equation
+    typename S::Work sum;
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+          sum = 0;
+            typename S::Coef CU = (u == 0) ? invSqrt2 : one;
+            typename S::Coef CV = (v == 0) ? invSqrt2 : one;
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) {
+                    sum += S::mul(S::mul(ogBlock[y + offsetY][x + offsetX], cosTableU[u][x]), cosTableV[v][y]);
+                }
+            }
+            block[v][u] = S::narrow(S::mul(S::mul(S::mul(sum, quarter), CU), CV));
+        }
+    }
+    return block;
+}
+/**Function to output 8x8 IDCT block, only coefficients whose bit is set in mask are used.
+ * Cost follows the nonzero corner: empty and DC-only blocks are a fill, a 4x4 corner is 16 terms per pixel**/
+template <typename T> void outputIDCTBlock(const vector<vector<T>> &ogBlock, int offsetX, int offsetY, const vector<vector<typename SampleTraits<T>::Coef>> &cosTableU, const vector<vector<typename SampleTraits<T>::Coef>> &cosTableV, T *block, uint64_t mask) {
+    using S = SampleTraits<T>;
+    // Masked load with CU * CV folded in (branch free so it compiles to a blend)
+    const typename S::Coef invSqrt2 = S::coef(1.0 / sqrt(2.0));
+    const typename S::Coef one = S::coef(1.0);
+    const typename S::Coef quarter = S::coef(0.25);
+    typename S::Work coeff[64];
+    for (int v = 0; v < 8; v++) {
+        const T *src = ogBlock[v + offsetY].data() + offsetX;
+        typename S::Coef CV = (v == 0) ? invSqrt2 : one;
+        for (int u = 0; u < 8; u++) {
+            typename S::Coef keep = static_cast<typename S::Coef>((mask >> (v * 8 + u)) & 1) * one;
+            typename S::Coef CU = (u == 0) ? invSqrt2 : one;
+            coeff[v * 8 + u] = S::mul(S::mul(S::mul(src[u], keep), CU), CV);
+        }
+    }
+    // Only the corner holding nonzero coefficients contributes (zero terms add nothing)
+    int vMax = 0;
+    int uMax = 0;
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            if (coeff[v * 8 + u] != 0) {
+                vMax = max(vMax, v + 1);
+                uMax = max(uMax, u + 1);
+            }
+        }
+    }
+    typename S::Work sum;
+    const typename S::Work low = S::fromDouble(0.0);
+    const typename S::Work high = S::fromDouble(255.0);
+    if (vMax == 0) {
+        // Empty block, the output is clamp(0) everywhere
+        fill(block, block + 64, S::narrow(low));
+        return;
+    }
+    if (vMax == 1 && uMax == 1) {
+        // DC only: cos(0) = 1 makes every pixel the same
+        T fillValue = S::narrow(clamp(S::mul(S::mul(S::mul(coeff[0], cosTableU[0][0]), cosTableV[0][0]), quarter), low, high));
+        fill(block, block + 64, fillValue);
+        return;
+    }
+    // Do the equation
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+          sum = 0;
+            for (int v = 0; v < vMax; v++) {
+                for (int u = 0; u < uMax; u++) {
+                    sum += S::mul(S::mul(coeff[v * 8 + u], cosTableU[u][x]), cosTableV[v][y]);
+                }
+            }
+            block[y * 8 + x] = S::narrow(clamp(S::mul(sum, quarter), low, high));
+        }
+    }
+}
+
+/**Cosine table converted to the constant type of T (built once per type)**/
+template <typename T> const vector<vector<typename SampleTraits<T>::Coef>> &cosineTable(){
+  static const vector<vector<typename SampleTraits<T>::Coef>> table = [] {
+    vector<vector<double>> reference = outputCosineTableU(8, 8);
+    vector<vector<typename SampleTraits<T>::Coef>> out(8, vector<typename SampleTraits<T>::Coef>(8));
+    for (int u = 0; u < 8; u++){
+      for (int x = 0; x < 8; x++){
+        out[u][x] = SampleTraits<T>::coef(reference[u][x]);
+      }
+    }
+    return out;
+  }();
+  return table;
+}
+
+/**Cosine Table Function**/
+vector<vector<double>> outputCosineTableV(int sizeY, int sizeX){
+  vector<vector<double>> table(sizeY, vector<double>(sizeX));
+  for (int v = 0; v < sizeY; v++) {
+      for (int y = 0; y < sizeY; y++) {
+          table[v][y] = cos((2.0 * y + 1.0) * v * M_PI / 16.0);
+        }
+      }
+  return table;
+}
+vector<vector<double>> outputCosineTableU(int sizeY, int sizeX){
+  vector<vector<double>> table(sizeY, vector<double>(sizeX));
+    for (int u = 0; u < sizeX; u++) {
+        for (int x = 0; x < sizeX; x++) {
+          table[u][x] = cos((2.0 * x + 1.0) * u * M_PI / 16.0);
+        }
+      }
+  return table;
+}
+
+/**
+ * Lifting-scheme DWT.
+ * Every 1D transform works on `lanes` signals stored interleaved (sample i of
+ * signal k at x[i * lanes + k]). Rows are lifted with lanes = 1 and columns are
+ * gathered DWT_COL_BLOCK at a time so each row is read/written sequentially.
+ * Output keeps the Mallat layout: low pass on the left/top, high pass on the
+ * right/bottom, recursing on the low-low quadrant.
+ **/
+//Lifting coefficients for CDF 9/7
+const double CDF97_ALPHA = -1.586134342059924;
+const double CDF97_BETA = -0.052980118572961;
+const double CDF97_GAMMA = 0.882911075530934;
+const double CDF97_DELTA = 0.443506852043971;
+//Scales so low pass has unit DC gain and high pass unit Nyquist gain (same as Haar avg/diff)
+const double CDF97_LOW_SCALE = 1.0 / 1.230174104914001;
+const double CDF97_HIGH_SCALE = -1.0 / 1.625786132232049;
+
+/**One lifting step: x[i] += coeff * (x[i-1] + x[i+1]) for i = parity, parity+2...**/
+template <typename T> void liftStep(T *x, int n, int lanes, int parity, double coeff){
+  using S = SampleTraits<T>;
+  const typename S::Coef c = S::coef(coeff);
+  for (int i = parity; i < n; i += 2){
+    //Symmetric extension at both edges
+    int left = (i > 0) ? i - 1 : i + 1;
+    int right = (i + 1 < n) ? i + 1 : i - 1;
+    T *xi = x + i * lanes;
+    const T *xl = x + left * lanes;
+    const T *xr = x + right * lanes;
+    for (int k = 0; k < lanes; k++){
+      xi[k] = S::narrow(xi[k] + S::mul(static_cast<typename S::Work>(xl[k]) + xr[k], c));
+    }
+  }
+}
+/**Integer 5/3 predict step: d -= floor((s[i] + s[i+1]) / 2), sign = -1 undoes it**/
+template <typename T> void liftPredict53(T *x, int n, int lanes, int sign){
+  using S = SampleTraits<T>;
+  for (int i = 1; i < n; i += 2){
+    int right = (i + 1 < n) ? i + 1 : i - 1;
+    T *xi = x + i * lanes;
+    const T *xl = x + (i - 1) * lanes;
+    const T *xr = x + right * lanes;
+    for (int k = 0; k < lanes; k++){
+      xi[k] = S::narrow(xi[k] - sign * S::floorShift(static_cast<typename S::Work>(xl[k]) + xr[k], 1));
+    }
+  }
+}
+/**Integer 5/3 update step: s += floor((d[i-1] + d[i] + 2) / 4), sign = -1 undoes it**/
+template <typename T> void liftUpdate53(T *x, int n, int lanes, int sign){
+  using S = SampleTraits<T>;
+  const typename S::Work two = S::fromDouble(2.0);
+  for (int i = 0; i < n; i += 2){
+    int left = (i > 0) ? i - 1 : i + 1;
+    int right = (i + 1 < n) ? i + 1 : i - 1;
+    T *xi = x + i * lanes;
+    const T *xl = x + left * lanes;
+    const T *xr = x + right * lanes;
+    for (int k = 0; k < lanes; k++){
+      xi[k] = S::narrow(xi[k] + sign * S::floorShift(static_cast<typename S::Work>(xl[k]) + xr[k] + two, 2));
+    }
+  }
+}
+/**Scale every sample with the given parity**/
+template <typename T> void liftScale(T *x, int n, int lanes, int parity, double scale){
+  using S = SampleTraits<T>;
+  const typename S::Coef c = S::coef(scale);
+  for (int i = parity; i < n; i += 2){
+    T *xi = x + i * lanes;
+    for (int k = 0; k < lanes; k++){
+      xi[k] = S::narrow(S::mul(xi[k], c));
+    }
+  }
+}
+
+/**Forward 1D lifting, results stay interleaved (even = low, odd = high)**/
+template <typename T> void liftForward(T *x, int n, int lanes, Wavelet wavelet){
+  using S = SampleTraits<T>;
+  if (n < 2){
+    return;
+  }
+  if (wavelet == HAAR){
+    //d = odd - even, s = even + d/2 (avg), then d = (even - odd)/2 (diff)
+    const typename S::Coef half = S::coef(0.5);
+    const typename S::Coef minusHalf = S::coef(-0.5);
+    for (int i = 1; i < n; i += 2){
+      T *s = x + (i - 1) * lanes;
+      T *d = x + i * lanes;
+      for (int k = 0; k < lanes; k++){
+        d[k] = S::narrow(static_cast<typename S::Work>(d[k]) - s[k]);
+        s[k] = S::narrow(s[k] + S::mul(d[k], half));
+        d[k] = S::narrow(S::mul(d[k], minusHalf));
+      }
+    }
+  } else if (wavelet == CDF53){
+    liftPredict53(x, n, lanes, 1);
+    liftUpdate53(x, n, lanes, 1);
+  } else {
+    liftStep(x, n, lanes, 1, CDF97_ALPHA);
+    liftStep(x, n, lanes, 0, CDF97_BETA);
+    liftStep(x, n, lanes, 1, CDF97_GAMMA);
+    liftStep(x, n, lanes, 0, CDF97_DELTA);
+    liftScale(x, n, lanes, 0, CDF97_LOW_SCALE);
+    liftScale(x, n, lanes, 1, CDF97_HIGH_SCALE);
+  }
+}
+/**Inverse 1D lifting on interleaved samples**/
+template <typename T> void liftInverse(T *x, int n, int lanes, Wavelet wavelet){
+  using S = SampleTraits<T>;
+  if (n < 2){
+    return;
+  }
+  if (wavelet == HAAR){
+    const typename S::Coef half = S::coef(0.5);
+    const typename S::Coef minusTwo = S::coef(-2.0);
+    for (int i = 1; i < n; i += 2){
+      T *s = x + (i - 1) * lanes;
+      T *d = x + i * lanes;
+      for (int k = 0; k < lanes; k++){
+        d[k] = S::narrow(S::mul(d[k], minusTwo));
+        s[k] = S::narrow(s[k] - S::mul(d[k], half));
+        d[k] = S::narrow(static_cast<typename S::Work>(d[k]) + s[k]);
+      }
+    }
+  } else if (wavelet == CDF53){
+    liftUpdate53(x, n, lanes, -1);
+    liftPredict53(x, n, lanes, -1);
+  } else {
+    liftScale(x, n, lanes, 1, 1.0 / CDF97_HIGH_SCALE);
+    liftScale(x, n, lanes, 0, 1.0 / CDF97_LOW_SCALE);
+    liftStep(x, n, lanes, 0, -CDF97_DELTA);
+    liftStep(x, n, lanes, 1, -CDF97_GAMMA);
+    liftStep(x, n, lanes, 0, -CDF97_BETA);
+    liftStep(x, n, lanes, 1, -CDF97_ALPHA);
+  }
+}
+
+/**Number of decomposition levels, -1 = recurse until a side reaches 1**/
+int dwtLevelCount(int height, int width, int levels){
+  int count = 0;
+  while (height > 1 && width > 1 && (levels < 0 || count < levels)){
+    height = (height + 1) / 2;
+    width = (width + 1) / 2;
+    count++;
+  }
+  return count;
+}
+
+/**Function to calculate DWT in place**/
+template <typename T> void outputDWT(vector<vector<T>> &block, int height, int width, Wavelet wavelet, int levels){
+  TRACE_SCOPE("dwt");
+  int levelCount = dwtLevelCount(height, width, levels);
+  vector<T> line(max(width, height * DWT_COL_BLOCK));
+  for (int level = 0; level < levelCount; level++){
+    int lowW = (width + 1) / 2;
+    int lowH = (height + 1) / 2;
+    //Row pass
+    for (int j = 0; j < height; j++){
+      T *row = block[j].data();
+      liftForward(row, width, 1, wavelet);
+      for (int i = 0; i < width; i++){
+        line[(i % 2 == 0) ? i / 2 : lowW + i / 2] = row[i];
+      }
+      copy(line.begin(), line.begin() + width, row);
+    }
+    //Column pass, DWT_COL_BLOCK columns at a time
+    for (int c = 0; c < width; c += DWT_COL_BLOCK){
+      int lanes = min(DWT_COL_BLOCK, width - c);
+      for (int i = 0; i < height; i++){
+        copy(block[i].begin() + c, block[i].begin() + c + lanes, line.begin() + i * lanes);
+      }
+      liftForward(line.data(), height, lanes, wavelet);
+      for (int i = 0; i < height; i++){
+        int dest = (i % 2 == 0) ? i / 2 : lowH + i / 2;
+        copy(line.begin() + i * lanes, line.begin() + (i + 1) * lanes, block[dest].begin() + c);
+      }
+    }
+    height = lowH;
+    width = lowW;
+  }
+}
+/**Function to calculate IDWT in place, output is clamped to 0 - 255**/
+template <typename T> void outputIDWT(vector<vector<T>> &block, int height, int width, Wavelet wavelet, int levels, int nonzeroRows, int nonzeroCols){
+  TRACE_SCOPE("idwt");
+  int levelCount = dwtLevelCount(height, width, levels);
+  //Everything outside rows x cols is zero and stays zero, so it is never lifted
+  int inputRows = (nonzeroRows < 0) ? height : min(nonzeroRows, height);
+  int inputCols = (nonzeroCols < 0) ? width : min(nonzeroCols, width);
+  int rows = (levelCount == 0) ? inputRows : 0;
+  int cols = (levelCount == 0) ? inputCols : 0;
+  //Size of the region transformed at each level (an int side halves at most 31 times)
+  int levelH[32];
+  int levelW[32];
+  int h = height;
+  int w = width;
+  for (int level = 0; level < levelCount; level++){
+    levelH[level] = h;
+    levelW[level] = w;
+    h = (h + 1) / 2;
+    w = (w + 1) / 2;
+  }
+  //Lifting scratch kept per thread, so decode steps after the first do not allocate
+  thread_local vector<T> line;
+  line.resize(max(static_cast<size_t>(width), static_cast<size_t>(height) * DWT_COL_BLOCK));
+  for (int level = levelCount - 1; level >= 0; level--){
+    h = levelH[level];
+    w = levelW[level];
+    int lowW = (w + 1) / 2;
+    int lowH = (h + 1) / 2;
+    //Reconstructed coarser band plus the input coefficients of this level
+    rows = min(h, max(rows, inputRows));
+    cols = min(w, max(cols, inputCols));
+    int lowRows = min(rows, lowH);
+    int lowCols = min(cols, lowW);
+    int highRows = max(rows - lowH, 0);
+    int highCols = max(cols - lowW, 0);
+    if (rows == 0 || cols == 0){
+      continue;
+    }
+    if (wavelet == HAAR && highRows == 0 && highCols == 0){
+      //Empty high bands: Haar synthesis is a pixel replicating upsample
+      rows = min(h, 2 * lowRows);
+      cols = min(w, 2 * lowCols);
+      for (int i = rows - 1; i >= 0; i--){
+        for (int j = cols - 1; j >= 0; j--){
+          block[i][j] = block[i / 2][j / 2];
+        }
+      }
+      continue;
+    }
+    //Nonzero samples spread at most one position per lifting step (4 steps at most)
+    rows = min(h, max(2 * lowRows, 2 * highRows) + 4);
+    //Column pass, only columns holding a nonzero coefficient
+    for (int c = 0; c < cols; c += DWT_COL_BLOCK){
+      int lanes = min(DWT_COL_BLOCK, w - c);
+      for (int i = 0; i < h; i++){
+        int src = (i % 2 == 0) ? i / 2 : lowH + i / 2;
+        copy(block[src].begin() + c, block[src].begin() + c + lanes, line.begin() + i * lanes);
+      }
+      liftInverse(line.data(), h, lanes, wavelet);
+      for (int i = 0; i < h; i++){
+        copy(line.begin() + i * lanes, line.begin() + (i + 1) * lanes, block[i].begin() + c);
+      }
+    }
+    //Row pass, rows past the column pass spread are still zero
+    for (int j = 0; j < rows; j++){
+      T *row = block[j].data();
+      for (int i = 0; i < w; i++){
+        line[i] = row[(i % 2 == 0) ? i / 2 : lowW + i / 2];
+      }
+      liftInverse(line.data(), w, 1, wavelet);
+      copy(line.begin(), line.begin() + w, row);
+    }
+    cols = min(w, max(2 * lowCols, 2 * highCols) + 4);
+  }
+
+  //Keep between 0 - 255
+  const T low = SampleTraits<T>::fromDouble(0.0);
+  const T high = SampleTraits<T>::fromDouble(255.0);
+  for (int y = 0; y < rows; y++){
+    for (int x = 0; x < cols; x++){
+      block[y][x] = clamp(block[y][x], low, high);
+    }
+  }
+}
+
+/**Lifting operations of liftForward as whole-row steps**/
+vector<LiftOp> liftProgram(Wavelet wavelet){
+  if (wavelet == HAAR){
+    return {{LIFT_HAAR_DIFF, 1, 0.0}, {LIFT_HAAR_AVG, 0, 0.0}, {LIFT_SCALE, 1, -0.5}};
+  } else if (wavelet == CDF53){
+    return {{LIFT_PREDICT53, 1, 0.0}, {LIFT_UPDATE53, 0, 0.0}};
+  }
+  return {{LIFT_LINEAR, 1, CDF97_ALPHA}, {LIFT_LINEAR, 0, CDF97_BETA}, {LIFT_LINEAR, 1, CDF97_GAMMA},
+          {LIFT_LINEAR, 0, CDF97_DELTA}, {LIFT_SCALE, 0, CDF97_LOW_SCALE}, {LIFT_SCALE, 1, CDF97_HIGH_SCALE}};
+}
+/**Same arithmetic as liftStep / liftPredict53 / liftUpdate53 / liftScale and the Haar pair loop**/
+void liftRow(const LiftOp &op, double *xi, const double *xl, const double *xr, int width){
+  if (op.kind == LIFT_HAAR_AVG && xr == NULL){
+    //Unpaired last row of an odd height stays as it is
+    return;
+  }
+  for (int k = 0; k < width; k++){
+    switch (op.kind){
+      case LIFT_LINEAR: xi[k] += (xl[k] + xr[k]) * op.coeff; break;
+      case LIFT_PREDICT53: xi[k] -= floor((xl[k] + xr[k]) / 2.0); break;
+      case LIFT_UPDATE53: xi[k] += floor((xl[k] + xr[k] + 2.0) / 4.0); break;
+      case LIFT_HAAR_DIFF: xi[k] -= xl[k]; break;
+      case LIFT_HAAR_AVG: xi[k] += xr[k] / 2.0; break;
+      case LIFT_SCALE: xi[k] *= op.coeff; break;
+    }
+  }
+}
+
+StreamingDWT::StreamingDWT(int height, int width, Wavelet wavelet, int levelLimit, RowSink sink)
+    : wavelet(wavelet), program(liftProgram(wavelet)), line(width), sink(sink) {
+  int levelCount = dwtLevelCount(height, width, levelLimit);
+  for (int level = 0; level < levelCount; level++){
+    Level L;
+    L.height = height;
+    L.width = width;
+    //Row i is last read by row i + 1's final operation, program.size() + 2 arrivals later
+    L.ring.assign(program.size() + 3, vector<double>(width));
+    levels.push_back(L);
+    height = (height + 1) / 2;
+    width = (width + 1) / 2;
+  }
+}
+void StreamingDWT::pushRow(const double *row){
+  if (levels.empty()){
+    //Nothing to transform, the row is its own LL band
+    sink(passedRows++, 0, row, line.size());
+    return;
+  }
+  feed(0, row);
+}
+size_t StreamingDWT::bufferedSamples() const {
+  size_t samples = line.size();
+  for (const Level &L : levels){
+    samples += L.ring.size() * L.width;
+  }
+  return samples;
+}
+/**Row pass of one incoming row, then run the column operations it unlocks**/
+void StreamingDWT::feed(int level, const double *input){
+  Level &L = levels[level];
+  int i = L.received++;
+  double *row = L.ring[i % L.ring.size()].data();
+  copy(input, input + L.width, row);
+  liftForward(row, L.width, 1, wavelet);
+  int lowW = (L.width + 1) / 2;
+  for (int k = 0; k < L.width; k++){
+    line[(k % 2 == 0) ? k / 2 : lowW + k / 2] = row[k];
+  }
+  copy(line.begin(), line.begin() + L.width, row);
+  advance(level, i);
+  if (i == L.height - 1){
+    //Flush: the bottom rows finish against the mirrored edge
+    for (int r = L.height; r <= L.height + static_cast<int>(program.size()); r++){
+      advance(level, r);
+    }
+  }
+}
+void StreamingDWT::advance(int level, int r){
+  Level &L = levels[level];
+  int ops = program.size();
+  for (int s = 0; s < ops; s++){
+    int i = r - s - 1;
+    if (i < 0 || i >= L.height || i % 2 != program[s].parity){
+      continue;
+    }
+    int left = (i > 0) ? i - 1 : i + 1;
+    int right = (i + 1 < L.height) ? i + 1 : i - 1;
+    const double *xr = L.ring[right % L.ring.size()].data();
+    if (program[s].kind == LIFT_HAAR_AVG && i + 1 >= L.height){
+      xr = NULL;
+    }
+    liftRow(program[s], L.ring[i % L.ring.size()].data(), L.ring[left % L.ring.size()].data(), xr, L.width);
+  }
+  int done = r - ops;
+  if (done >= 0 && done < L.height){
+    emit(level, done);
+  }
+}
+/**Send a finished row to the sink, the low half of even rows goes down a level**/
+void StreamingDWT::emit(int level, int i){
+  Level &L = levels[level];
+  const double *row = L.ring[i % L.ring.size()].data();
+  int lowW = (L.width + 1) / 2;
+  int lowH = (L.height + 1) / 2;
+  if (i % 2 == 1){
+    sink(lowH + i / 2, 0, row, L.width);
+    return;
+  }
+  sink(i / 2, lowW, row + lowW, L.width - lowW);
+  if (level + 1 < static_cast<int>(levels.size())){
+    feed(level + 1, row);
+  } else {
+    sink(i / 2, 0, row, lowW);
+  }
+}
+
+/**Headless --stream-dwt: transform each channel while reading it, a few rows in memory per level**/
+void runStreamDWT(string imagePath, string outPath){
+  TRACE_SCOPE("stream dwt");
+  int width;
+  int height;
+  imageDimensions(imagePath, width, height);
+  ifstream inputFile(imagePath, ios::binary);
+  if (!inputFile.is_open()) {
+    cerr << "Error Opening File for Reading" << endl;
+    exit(1);
+  }
+  fstream outputFile(outPath, ios::binary | ios::in | ios::out | ios::trunc);
+  if (!outputFile.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  auto start = chrono::steady_clock::now();
+  vector<char> buf(width);
+  vector<double> row(width);
+  vector<float> out(width);
+  size_t buffered = 0;
+  for (int channel = 0; channel < 3; channel++){
+    //Subband rows land anywhere in the plane, so write them in place
+    streamoff planeStart = static_cast<streamoff>(channel) * width * height * sizeof(float);
+    StreamingDWT dwt(height, width, dwtWavelet, dwtLevels, [&](int r, int col, const double *data, int count) {
+      copy(data, data + count, out.begin());
+      outputFile.seekp(planeStart + (static_cast<streamoff>(r) * width + col) * sizeof(float));
+      outputFile.write(reinterpret_cast<const char *>(out.data()), count * sizeof(float));
+    });
+    for (int i = 0; i < height; i++){
+      if (!inputFile.read(buf.data(), width)){
+        cerr << "Image file is shorter than " << width << "x" << height << endl;
+        exit(1);
+      }
+      for (int j = 0; j < width; j++){
+        row[j] = static_cast<unsigned char>(buf[j]);
+      }
+      dwt.pushRow(row.data());
+    }
+    buffered = dwt.bufferedSamples();
+  }
+  outputFile.close();
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "Wrote " << width << "x" << height << " float32 Mallat planes (" << dwtLevelCount(height, width, dwtLevels) << " levels) to " << outPath << endl;
+  cout << "Row buffers: " << buffered * sizeof(double) / 1024.0 << " KiB per channel (" << buffered / static_cast<double>(width) << " rows of " << width << ")" << endl;
+  cout << "MB/s: " << width * static_cast<double>(height) * 3 / 1.0e6 / seconds << endl;
+}
+
+/**
+ * Compressed file format (.cmp)
+ * Header: "C576", version, method (0 = DCT, 1 = DWT), wavelet, quality,
+ * width (u32), height (u32), DWT levels, chroma format. Then per channel
+ * (R, G, B or Y, Cb, Cr at chroma resolution): table count, the
+ * Huffman tables (16 code length counts + symbols, same as JPEG DHT),
+ * payload size (u32) and the payload bits (MSB first).
+ * DCT: JPEG luminance table (chrominance for Cb, Cr) scaled by quality, DPCM DC sizes and zigzag
+ * (run, size) AC symbols with EOB/ZRL. Edges are padded to whole 8x8 blocks.
+ * DWT: one dead zone quantizer step per decomposition level, subbands coded coarse to
+ * fine. LL uses DPCM DC sizes, every high band is (run, size) coded and
+ * closed with EOB, coarse and fine levels get separate AC tables.
+ **/
+void writeU32(vector<unsigned char> &out, uint32_t value){
+  for (int i = 0; i < 4; i++){
+    out.push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+uint32_t readU32(const unsigned char *in){
+  return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+bool streamSizeValid(uint32_t width, uint32_t height){
+  return width > 0 && height > 0 && width <= CODEC_MAX_DIMENSION && height <= CODEC_MAX_DIMENSION &&
+         static_cast<size_t>(width) * height <= CODEC_MAX_PIXELS;
+}
+
+/**MSB first bit writer**/
+struct BitWriter {
+  vector<unsigned char> bytes;
+  uint64_t acc = 0;
+  int count = 0;
+  void put(uint32_t value, int length){
+    acc = (acc << length) | (value & ((1u << length) - 1));
+    count += length;
+    while (count >= 8){
+      count -= 8;
+      bytes.push_back((acc >> count) & 0xFF);
+    }
+  }
+  void flush(){
+    if (count > 0){
+      bytes.push_back((acc << (8 - count)) & 0xFF);
+    }
+    acc = 0;
+    count = 0;
+  }
+};
+/**MSB first bit reader, keeps up to 64 bits buffered (left aligned)**/
+struct BitReader {
+  const unsigned char *data;
+  size_t size;
+  size_t pos = 0;
+  uint64_t acc = 0;
+  int count = 0;
+  BitReader(const unsigned char *data, size_t size) : data(data), size(size) {}
+  uint32_t peek(int length){
+    while (count <= 56){
+      uint64_t byte = (pos < size) ? data[pos] : 0;
+      acc |= byte << (56 - count);
+      pos++;
+      count += 8;
+    }
+    return (length == 0) ? 0 : static_cast<uint32_t>(acc >> (64 - length));
+  }
+  void skip(int length){
+    acc <<= length;
+    count -= length;
+  }
+  uint32_t get(int length){
+    uint32_t value = peek(length);
+    skip(length);
+    return value;
+  }
+  size_t bitsUsed() const {
+    return pos * 8 - count;
+  }
+};
+
+/**Canonical Huffman table with a HUFF_LOOKUP_BITS fast decode table**/
+struct HuffmanTable {
+  unsigned char bits[17] = {0};
+  vector<unsigned char> vals;
+  uint16_t code[256] = {0};
+  unsigned char length[256] = {0};
+  int maxcode[18];
+  int mincode[17];
+  int valptr[17];
+  //(length << 8) | symbol, 0 means the code is longer than the lookup
+  uint16_t lookup[1 << HUFF_LOOKUP_BITS];
+};
+
+/**Derive codes, slow path limits and the lookup table from bits/vals**/
+void finishHuffmanTable(HuffmanTable &table){
+  fill(begin(table.lookup), end(table.lookup), 0);
+  int code = 0;
+  int k = 0;
+  for (int l = 1; l <= 16; l++){
+    table.valptr[l] = k;
+    table.mincode[l] = code;
+    for (int i = 0; i < table.bits[l]; i++){
+      unsigned char symbol = table.vals[k];
+      table.code[symbol] = code;
+      table.length[symbol] = l;
+      if (l <= HUFF_LOOKUP_BITS){
+        int shift = HUFF_LOOKUP_BITS - l;
+        for (int fill = 0; fill < (1 << shift); fill++){
+          table.lookup[(code << shift) | fill] = (l << 8) | symbol;
+        }
+      }
+      code++;
+      k++;
+    }
+    table.maxcode[l] = table.bits[l] ? code - 1 : -1;
+    code <<= 1;
+  }
+  table.maxcode[17] = INT32_MAX;
+}
+
+/**Build a length limited (16 bit) Huffman table from symbol counts**/
+void buildHuffmanTable(const vector<long> &freq, HuffmanTable &table){
+  vector<int> codeLength(256, 0);
+  vector<int> parent(512, -1);
+  priority_queue<pair<long, int>, vector<pair<long, int>>, greater<pair<long, int>>> heap;
+  for (int s = 0; s < 256; s++){
+    if (freq[s] > 0){
+      heap.push({freq[s], s});
+    }
+  }
+  int used = heap.size();
+  int nodes = 256;
+  while (heap.size() > 1){
+    pair<long, int> a = heap.top();
+    heap.pop();
+    pair<long, int> b = heap.top();
+    heap.pop();
+    parent[a.second] = nodes;
+    parent[b.second] = nodes;
+    heap.push({a.first + b.first, nodes});
+    nodes++;
+  }
+  for (int s = 0; s < 256; s++){
+    if (freq[s] > 0){
+      int depth = 0;
+      for (int node = s; parent[node] >= 0; node = parent[node]){
+        depth++;
+      }
+      //A lone symbol still needs one bit
+      codeLength[s] = (used == 1) ? 1 : depth;
+    }
+  }
+  //Limit code lengths to 16 bits (JPEG Annex K.3)
+  vector<int> count(257, 0);
+  for (int s = 0; s < 256; s++){
+    count[codeLength[s]]++;
+  }
+  for (int l = 256; l > 16; l--){
+    while (count[l] > 0){
+      int j = l - 2;
+      while (count[j] == 0){
+        j--;
+      }
+      count[l] -= 2;
+      count[l - 1]++;
+      count[j + 1] += 2;
+      count[j]--;
+    }
+  }
+  //Symbols in order of their original code length
+  vector<int> order;
+  for (int s = 0; s < 256; s++){
+    if (freq[s] > 0){
+      order.push_back(s);
+    }
+  }
+  stable_sort(order.begin(), order.end(), [&](int a, int b) { return codeLength[a] < codeLength[b]; });
+  table.vals.assign(order.begin(), order.end());
+  for (int l = 1; l <= 16; l++){
+    table.bits[l] = count[l];
+  }
+  finishHuffmanTable(table);
+}
+
+/**Decode one symbol, -1 on a corrupt stream**/
+int decodeHuffman(BitReader &reader, const HuffmanTable &table){
+  uint16_t entry = table.lookup[reader.peek(HUFF_LOOKUP_BITS)];
+  if (entry != 0){
+    reader.skip(entry >> 8);
+    return entry & 0xFF;
+  }
+  //Slow path for codes longer than the lookup
+  uint32_t bits16 = reader.peek(16);
+  for (int l = HUFF_LOOKUP_BITS + 1; l <= 16; l++){
+    int code = bits16 >> (16 - l);
+    if (table.maxcode[l] >= 0 && code <= table.maxcode[l]){
+      reader.skip(l);
+      return table.vals[table.valptr[l] + code - table.mincode[l]];
+    }
+  }
+  return -1;
+}
+
+/**JPEG style amplitude category and bits**/
+int magnitudeSize(int value){
+  value = abs(value);
+  int size = 0;
+  while (value){
+    size++;
+    value >>= 1;
+  }
+  return size;
+}
+int extendAmplitude(uint32_t bits, int size){
+  if (size == 0){
+    return 0;
+  }
+  return (bits < (1u << (size - 1))) ? static_cast<int>(bits) - (1 << size) + 1 : static_cast<int>(bits);
+}
+
+/**Symbol plus amplitude bits, collected before the tables exist**/
+struct CodedSymbol {
+  unsigned char table;
+  unsigned char symbol;
+  unsigned char extraLength;
+  uint16_t extra;
+};
+void pushSymbol(vector<CodedSymbol> &out, int table, int run, int value){
+  int size = magnitudeSize(value);
+  uint32_t extra = (value >= 0) ? value : value + (1 << size) - 1;
+  out.push_back({static_cast<unsigned char>(table), static_cast<unsigned char>((run << 4) | size), static_cast<unsigned char>(size), static_cast<uint16_t>(extra)});
+}
+/**(run, size) code a sequence, ending with EOB if it ends in zeros**/
+void pushACRun(vector<CodedSymbol> &out, int table, const int *values, int count){
+  int run = 0;
+  for (int i = 0; i < count; i++){
+    if (values[i] == 0){
+      run++;
+      continue;
+    }
+    while (run > 15){
+      out.push_back({static_cast<unsigned char>(table), HUFF_ZRL, 0, 0});
+      run -= 16;
+    }
+    pushSymbol(out, table, run, values[i]);
+    run = 0;
+  }
+  if (run > 0){
+    out.push_back({static_cast<unsigned char>(table), HUFF_EOB, 0, 0});
+  }
+}
+bool readACRun(BitReader &reader, const HuffmanTable &table, int *values, int count){
+  fill(values, values + count, 0);
+  int i = 0;
+  while (i < count){
+    int symbol = decodeHuffman(reader, table);
+    if (symbol < 0){
+      return false;
+    }
+    if (symbol == HUFF_EOB){
+      break;
+    }
+    if (symbol == HUFF_ZRL){
+      i += 16;
+      continue;
+    }
+    int size = symbol & 15;
+    i += symbol >> 4;
+    if (i >= count){
+      return false;
+    }
+    values[i++] = extendAmplitude(reader.get(size), size);
+  }
+  return true;
+}
+bool readDC(BitReader &reader, const HuffmanTable &table, int &value){
+  int size = decodeHuffman(reader, table);
+  if (size < 0 || size > CODEC_MAX_SIZE){
+    return false;
+  }
+  value = extendAmplitude(reader.get(size), size);
+  return true;
+}
+
+/**Quantization**/
+int qualityScale(int quality){
+  quality = clamp(quality, 1, 100);
+  return (quality < 50) ? 5000 / quality : 200 - 2 * quality;
+}
+//Reciprocals of every step, computed once per table
+void finishQuantizer(Quantizer &quant){
+  quant.reciprocal.resize(quant.step.size());
+  for (size_t i = 0; i < quant.step.size(); i++){
+    quant.reciprocal[i] = 1.0 / quant.step[i];
+  }
+}
+//JPEG luma or chroma table scaled by quality, raster order, round to nearest
+Quantizer dctQuantizer(int quality, bool chroma){
+  const int *base = chroma ? jpegChromaTable : jpegLumaTable;
+  int scale = qualityScale(quality);
+  Quantizer quant;
+  quant.step.resize(64);
+  for (int i = 0; i < 64; i++){
+    quant.step[i] = clamp((base[i] * scale + 50) / 100, 1, 255);
+  }
+  quant.rounding = 0.5;
+  quant.bias = 0.0;
+  finishQuantizer(quant);
+  return quant;
+}
+//Step for a DWT level (0 = finest), halves per level to match the averaging filters
+double dwtLevelStep(int quality, int level, Wavelet wavelet){
+  double base = max(qualityScale(quality), 1) / 10.0;
+  double step = max(base / pow(2.0, level), 0.125);
+  //5/3 coefficients are integers, integer steps keep quality 100 lossless
+  return (wavelet == CDF53) ? max(round(step), 1.0) : step;
+}
+//Dead zone uniform quantizer for one subband row of count coefficients
+Quantizer dwtQuantizer(int quality, int level, Wavelet wavelet, int count){
+  Quantizer quant;
+  quant.step.assign(count, dwtLevelStep(quality, level, wavelet));
+  quant.rounding = DWT_DEAD_ZONE_ROUNDING;
+  //A unit step on integer 5/3 coefficients is exact, reconstruct on the integer
+  quant.bias = (wavelet == CDF53 && quant.step[0] == 1.0) ? 0.0 : DWT_RECONSTRUCTION_BIAS;
+  finishQuantizer(quant);
+  return quant;
+}
+//q = sign(x) * floor(|x| / step + rounding), branch free so the loop vectorizes
+void quantizeValues(const double *values, const Quantizer &quant, int *out){
+  const double *reciprocal = quant.reciprocal.data();
+  const double rounding = quant.rounding;
+  int count = quant.step.size();
+  for (int i = 0; i < count; i++){
+    double magnitude = min(fabs(values[i]) * reciprocal[i] + rounding, 32767.0);
+    int q = static_cast<int>(magnitude);
+    out[i] = (values[i] < 0) ? -q : q;
+  }
+}
+void dequantizeValues(const int *values, const Quantizer &quant, double *out){
+  const double *step = quant.step.data();
+  const double bias = quant.bias;
+  int count = quant.step.size();
+  for (int i = 0; i < count; i++){
+    double offset = (values[i] > 0) ? bias : ((values[i] < 0) ? -bias : 0.0);
+    out[i] = (values[i] + offset) * step[i];
+  }
+}
+
+/**Subbands of a multi-level DWT, coarse to fine (LL first)**/
+vector<Subband> dwtSubbands(int height, int width, int levels){
+  int levelCount = dwtLevelCount(height, width, levels);
+  vector<int> levelH(levelCount + 1);
+  vector<int> levelW(levelCount + 1);
+  levelH[0] = height;
+  levelW[0] = width;
+  for (int level = 0; level < levelCount; level++){
+    levelH[level + 1] = (levelH[level] + 1) / 2;
+    levelW[level + 1] = (levelW[level] + 1) / 2;
+  }
+  vector<Subband> bands;
+  bands.push_back({0, 0, levelH[levelCount], levelW[levelCount], levelCount});
+  for (int level = levelCount - 1; level >= 0; level--){
+    int h = levelH[level];
+    int w = levelW[level];
+    int lowH = levelH[level + 1];
+    int lowW = levelW[level + 1];
+    bands.push_back({0, lowW, lowH, w - lowW, level});
+    bands.push_back({lowH, 0, h - lowH, lowW, level});
+    bands.push_back({lowH, lowW, h - lowH, w - lowW, level});
+  }
+  return bands;
+}
+
+/**Turn one channel into symbols (tables: 0 = DC, 1 = AC / AC coarse, 2 = AC fine)**/
+vector<CodedSymbol> symbolizeChannel(const vector<vector<double>> &plane, int width, int height, bool isDCT, int quality, bool chroma, Wavelet wavelet, int levels){
+  TRACE_SCOPE("symbolize");
+  vector<CodedSymbol> out;
+  if (isDCT){
+    Quantizer quant = dctQuantizer(quality, chroma);
+    int prevDC = 0;
+    double values[64];
+    int quantized[64];
+    int coeffs[64];
+    //Edge padded to whole blocks, the decoder crops it off
+    vector<vector<double>> padded = padPlane(plane, (height + 7) / 8 * 8, (width + 7) / 8 * 8);
+    for (int by = 0; by < height; by += 8){
+      for (int bx = 0; bx < width; bx += 8){
+        vector<vector<double>> block = outputDCTBlock(padded, bx, by, cosTableU, cosTableV);
+        for (int y = 0; y < 8; y++){
+          copy(block[y].begin(), block[y].end(), values + y * 8);
+        }
+        quantizeValues(values, quant, quantized);
+        for (int k = 0; k < 64; k++){
+          coeffs[k] = quantized[ZIGZAG.index[k]];
+        }
+        pushSymbol(out, 0, 0, coeffs[0] - prevDC);
+        prevDC = coeffs[0];
+        pushACRun(out, 1, coeffs + 1, 63);
+      }
+    }
+  } else {
+    vector<vector<double>> coeffs = plane;
+    outputDWT(coeffs, height, width, wavelet, levels);
+    vector<int> values;
+    for (const Subband &band : dwtSubbands(height, width, levels)){
+      Quantizer quant = dwtQuantizer(quality, band.level, wavelet, band.w);
+      values.assign(band.h * band.w, 0);
+      for (int i = 0; i < band.h; i++){
+        quantizeValues(coeffs[band.y0 + i].data() + band.x0, quant, values.data() + i * band.w);
+      }
+      if (band.y0 == 0 && band.x0 == 0){
+        //LL: DPCM in raster order
+        int prev = 0;
+        for (int v : values){
+          pushSymbol(out, 0, 0, v - prev);
+          prev = v;
+        }
+      } else {
+        pushACRun(out, (band.level >= 2) ? 1 : 2, values.data(), values.size());
+      }
+    }
+  }
+  return out;
+}
+
+/**Inverse of symbolizeChannel: entropy decode, dequantize, inverse transform**/
+bool decodeChannel(BitReader &reader, const vector<HuffmanTable> &tables, vector<vector<double>> &plane, int width, int height, bool isDCT, int quality, bool chroma, Wavelet wavelet, int levels){
+  TRACE_SCOPE("entropy decode");
+  if (isDCT){
+    //Decode whole blocks, then drop the edge padding
+    int paddedWidth = (width + 7) / 8 * 8;
+    int paddedHeight = (height + 7) / 8 * 8;
+    vector<vector<double>> padded(paddedHeight, vector<double>(paddedWidth, 0.0));
+    Quantizer quant = dctQuantizer(quality, chroma);
+    vector<vector<double>> block(8, vector<double>(8));
+    int prevDC = 0;
+    int coeffs[64];
+    int quantized[64];
+    double values[64];
+    for (int by = 0; by < height; by += 8){
+      for (int bx = 0; bx < width; bx += 8){
+        int diff;
+        if (!readDC(reader, tables[0], diff) || !readACRun(reader, tables[1], coeffs + 1, 63)){
+          return false;
+        }
+        coeffs[0] = prevDC + diff;
+        prevDC = coeffs[0];
+        for (int k = 0; k < 64; k++){
+          quantized[ZIGZAG.index[k]] = coeffs[k];
+        }
+        dequantizeValues(quantized, quant, values);
+        for (int y = 0; y < 8; y++){
+          copy(values + y * 8, values + y * 8 + 8, block[y].begin());
+        }
+        double pixels[64];
+        outputIDCTBlock(block, 0, 0, cosTableU, cosTableV, pixels);
+        for (int y = 0; y < 8; y++){
+          copy(pixels + y * 8, pixels + y * 8 + 8, padded[by + y].begin() + bx);
+        }
+      }
+    }
+    plane = cropPlane(padded, height, width);
+  } else {
+    plane.assign(height, vector<double>(width, 0.0));
+    vector<int> values;
+    for (const Subband &band : dwtSubbands(height, width, levels)){
+      Quantizer quant = dwtQuantizer(quality, band.level, wavelet, band.w);
+      values.assign(band.h * band.w, 0);
+      if (band.y0 == 0 && band.x0 == 0){
+        int prev = 0;
+        for (int &v : values){
+          int diff;
+          if (!readDC(reader, tables[0], diff)){
+            return false;
+          }
+          v = prev + diff;
+          prev = v;
+        }
+      } else if (!readACRun(reader, tables[(band.level >= 2) ? 1 : 2], values.data(), values.size())){
+        return false;
+      }
+      for (int i = 0; i < band.h; i++){
+        dequantizeValues(values.data() + i * band.w, quant, plane[band.y0 + i].data() + band.x0);
+      }
+    }
+    outputIDWT(plane, height, width, wavelet, levels);
+  }
+  return true;
+}
+
+/**Encode three channels into a .cmp file image**/
+vector<unsigned char> encodeImage(const vector<vector<double>> &red, const vector<vector<double>> &green, const vector<vector<double>> &blue, int width, int height, bool isDCT, int quality, Wavelet wavelet){
+  TRACE_SCOPE("encode file");
+  int levels = dwtLevelCount(height, width, dwtLevels);
+  ImagePlanes image;
+  image.width = width;
+  image.height = height;
+  image.red = red;
+  image.green = green;
+  image.blue = blue;
+  if (chromaFormat != CHROMA_RGB){
+    image = toYCbCr(image, chromaFormat);
+  }
+  vector<unsigned char> file = {'C', '5', '7', '6', CODEC_VERSION};
+  file.push_back(isDCT ? 0 : 1);
+  file.push_back(static_cast<unsigned char>(wavelet));
+  file.push_back(static_cast<unsigned char>(quality));
+  writeU32(file, width);
+  writeU32(file, height);
+  file.push_back(static_cast<unsigned char>(levels));
+  file.push_back(static_cast<unsigned char>(image.chroma));
+  int tableCount = isDCT ? 2 : 3;
+  const vector<vector<double>> *planes[3] = {&image.red, &image.green, &image.blue};
+  for (int c = 0; c < 3; c++){
+    int planeWidth;
+    int planeHeight;
+    planeSize(image.chroma, c, width, height, planeWidth, planeHeight);
+    //Cb and Cr use the chroma table
+    bool chroma = image.chroma != CHROMA_RGB && c > 0;
+    vector<CodedSymbol> symbols = symbolizeChannel(*planes[c], planeWidth, planeHeight, isDCT, quality, chroma, wavelet, dwtLevelCount(planeHeight, planeWidth, levels));
+    //Pass 1: statistics and tables
+    vector<vector<long>> freq(tableCount, vector<long>(256, 0));
+    for (const CodedSymbol &s : symbols){
+      freq[s.table][s.symbol]++;
+    }
+    vector<HuffmanTable> tables(tableCount);
+    file.push_back(tableCount);
+    for (int t = 0; t < tableCount; t++){
+      buildHuffmanTable(freq[t], tables[t]);
+      file.insert(file.end(), tables[t].bits + 1, tables[t].bits + 17);
+      file.insert(file.end(), tables[t].vals.begin(), tables[t].vals.end());
+    }
+    //Pass 2: bits
+    BitWriter writer;
+    for (const CodedSymbol &s : symbols){
+      const HuffmanTable &table = tables[s.table];
+      writer.put(table.code[s.symbol], table.length[s.symbol]);
+      writer.put(s.extra, s.extraLength);
+    }
+    writer.flush();
+    writeU32(file, writer.bytes.size());
+    file.insert(file.end(), writer.bytes.begin(), writer.bytes.end());
+  }
+  return file;
+}
+
+/**Decode a .cmp file image, false if the data is not a valid stream**/
+bool decodeImage(const vector<unsigned char> &file, vector<vector<double>> &red, vector<vector<double>> &green, vector<vector<double>> &blue, int &width, int &height){
+  TRACE_SCOPE("decode file");
+  const size_t headerSize = 18;
+  if (file.size() < headerSize || file[0] != 'C' || file[1] != '5' || file[2] != '7' || file[3] != '6' || file[4] != CODEC_VERSION){
+    return false;
+  }
+  bool isDCT = file[5] == 0;
+  Wavelet wavelet = static_cast<Wavelet>(file[6]);
+  int quality = file[7];
+  if (!streamSizeValid(readU32(&file[8]), readU32(&file[12]))){
+    return false;
+  }
+  width = readU32(&file[8]);
+  height = readU32(&file[12]);
+  int levels = file[16];
+  ImagePlanes image;
+  image.width = width;
+  image.height = height;
+  image.chroma = static_cast<ChromaFormat>(file[17]);
+  if (wavelet > CDF97 || levels > dwtLevelCount(height, width, -1) || image.chroma > CHROMA_420){
+    return false;
+  }
+  size_t pos = headerSize;
+  vector<vector<double>> *planes[3] = {&image.red, &image.green, &image.blue};
+  for (int c = 0; c < 3; c++){
+    int planeWidth;
+    int planeHeight;
+    planeSize(image.chroma, c, width, height, planeWidth, planeHeight);
+    if (pos >= file.size()){
+      return false;
+    }
+    int tableCount = file[pos++];
+    vector<HuffmanTable> tables(tableCount);
+    for (HuffmanTable &table : tables){
+      if (pos + 16 > file.size()){
+        return false;
+      }
+      int total = 0;
+      //Codes of each length must fit the code space left by the shorter ones
+      bool fits = true;
+      int code = 0;
+      for (int l = 1; l <= 16; l++){
+        table.bits[l] = file[pos++];
+        total += table.bits[l];
+        fits = fits && code + table.bits[l] <= (1 << l);
+        code = (code + table.bits[l]) << 1;
+      }
+      if (!fits || total > 256 || pos + total > file.size()){
+        return false;
+      }
+      table.vals.assign(file.begin() + pos, file.begin() + pos + total);
+      pos += total;
+      finishHuffmanTable(table);
+    }
+    if (tableCount < (isDCT ? 2 : 3) || pos + 4 > file.size()){
+      return false;
+    }
+    size_t payload = readU32(&file[pos]);
+    pos += 4;
+    if (pos + payload > file.size()){
+      return false;
+    }
+    BitReader reader(file.data() + pos, payload);
+    bool chroma = image.chroma != CHROMA_RGB && c > 0;
+    if (!decodeChannel(reader, tables, *planes[c], planeWidth, planeHeight, isDCT, quality, chroma, wavelet, dwtLevelCount(planeHeight, planeWidth, levels))){
+      return false;
+    }
+    pos += payload;
+  }
+  if (image.chroma != CHROMA_RGB){
+    toRGB(image);
+  }
+  red = move(image.red);
+  green = move(image.green);
+  blue = move(image.blue);
+  return true;
+}
+
+/**Headless --encode: compress, write the file and report size and speed**/
+void runEncode(string imagePath, string outPath, int quality, bool isDCT){
+  int width;
+  int height;
+  imageDimensions(imagePath, width, height);
+  ImagePlanes image = loadImage2D(imagePath, width, height);
+  auto start = chrono::steady_clock::now();
+  vector<unsigned char> file = encodeImage(image.red, image.green, image.blue, width, height, isDCT, quality, dwtWavelet);
+  double encodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  ofstream outputFile(outPath, ios::binary);
+  if (!outputFile.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  outputFile.write(reinterpret_cast<const char *>(file.data()), file.size());
+  outputFile.close();
+
+  //Decode back to report decode speed
+  vector<vector<double>> red;
+  vector<vector<double>> green;
+  vector<vector<double>> blue;
+  start = chrono::steady_clock::now();
+  decodeImage(file, red, green, blue, width, height);
+  double decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  double rawMB = width * height * 3 / 1.0e6;
+  cout << (isDCT ? "DCT" : "DWT") << " quality " << quality << endl;
+  cout << "Compressed bytes: " << file.size() << endl;
+  cout << "Bits per pixel: " << file.size() * 8.0 / (width * height) << endl;
+  cout << "Encode MB/s: " << rawMB / encodeSeconds << endl;
+  cout << "Decode MB/s: " << rawMB / decodeSeconds << endl;
+}
+
+/**Headless --decode: read a .cmp file and write a planar .rgb file**/
+void runDecode(string inPath, string outPath){
+  ifstream inputFile(inPath, ios::binary);
+  if (!inputFile.is_open()) {
+    cerr << "Error Opening File for Reading" << endl;
+    exit(1);
+  }
+  vector<unsigned char> file((istreambuf_iterator<char>(inputFile)), istreambuf_iterator<char>());
+  inputFile.close();
+
+  vector<vector<double>> red;
+  vector<vector<double>> green;
+  vector<vector<double>> blue;
+  int width;
+  int height;
+  auto start = chrono::steady_clock::now();
+  if (!decodeImage(file, red, green, blue, width, height)){
+    cerr << "Not a valid compressed file" << endl;
+    exit(1);
+  }
+  double decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  ofstream outputFile(outPath, ios::binary);
+  if (!outputFile.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  for (const vector<vector<double>> *plane : {&red, &green, &blue}){
+    vector<unsigned char> buf = to1D(*plane, height, width);
+    outputFile.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+  }
+  outputFile.close();
+  cout << "Decoded " << width << "x" << height << " from " << file.size() << " bytes" << endl;
+  cout << "Decode MB/s: " << width * height * 3 / 1.0e6 / decodeSeconds << endl;
+}
+
+/**
+ * Embedded wavelet bitstream (.spt), SPIHT style.
+ * Coefficients of all three channels are coded bit plane by bit plane
+ * (sorting pass + refinement pass per channel), so any prefix of the file is
+ * a valid lower quality image.
+ * Header: "S576", version, wavelet, levels, top bit plane, width (u32), height (u32).
+ * The coded planes are edge padded to multiples of 2^EMBED_MAX_LEVELS.
+ * Trees: an LL coefficient (i, j) has children (i, j + wL), (i + hL, j) and
+ * (i + hL, j + wL); any other (i, j) has the 2x2 block at (2i, 2j).
+ **/
+//Images are edge padded to a multiple of 2^EMBED_MAX_LEVELS
+int embeddedPaddedSize(int size){
+  int unit = 1 << EMBED_MAX_LEVELS;
+  return (size + unit - 1) / unit * unit;
+}
+//Levels that keep every subband dyadic, so the parent/child trees line up
+int embeddedLevels(int height, int width){
+  int levels = 0;
+  while (levels < EMBED_MAX_LEVELS && height % (2 << levels) == 0 && width % (2 << levels) == 0){
+    levels++;
+  }
+  return levels;
+}
+
+/**Bit plane coder shared by the encoder (writer set) and decoder (reader set)**/
+class SpihtCoder {
+ public:
+  SpihtCoder(int height, int width, int levels) : height(height), width(width), levels(levels) {
+    hL = height >> levels;
+    wL = width >> levels;
+  }
+  //Encoder: integer magnitudes and signs of each channel
+  void setChannels(const vector<vector<int>> &magnitudes, const vector<vector<int>> &signs){
+    mags = magnitudes;
+    sgns = signs;
+    descMax.assign(mags.size(), vector<int>());
+    gdescMax.assign(mags.size(), vector<int>());
+    for (size_t ch = 0; ch < mags.size(); ch++){
+      computeTreeMax(ch);
+    }
+  }
+  //Decoder: reconstructed values of each channel
+  vector<vector<double>> rec;
+  BitWriter *writer = nullptr;
+  BitReader *reader = nullptr;
+  size_t limitBits = 0;
+  bool done = false;
+
+  void run(int topPlane, int channels){
+    lip.assign(channels, vector<int>());
+    lis.assign(channels, vector<pair<int, bool>>());
+    lsp.assign(channels, vector<int>());
+    if (!writer){
+      rec.assign(channels, vector<double>(height * width, 0.0));
+      sgns.assign(channels, vector<int>(height * width, 1));
+    }
+    for (int ch = 0; ch < channels; ch++){
+      for (int i = 0; i < hL; i++){
+        for (int j = 0; j < wL; j++){
+          lip[ch].push_back(i * width + j);
+          if (levels > 0){
+            lis[ch].push_back({i * width + j, true});
+          }
+        }
+      }
+    }
+    for (int n = topPlane; n >= 0 && !done; n--){
+      for (int ch = 0; ch < channels && !done; ch++){
+        size_t lspBefore = lsp[ch].size();
+        sortingPass(ch, n);
+        refinementPass(ch, n, lspBefore);
+      }
+    }
+  }
+
+ private:
+  int height, width, levels, hL, wL;
+  vector<vector<int>> mags, sgns, descMax, gdescMax;
+  vector<vector<int>> lip, lsp;
+  //(index, type A)
+  vector<vector<pair<int, bool>>> lis;
+
+  //Write the bit when encoding, read it when decoding
+  int code(int bit){
+    if (writer){
+      writer->put(bit, 1);
+      return bit;
+    }
+    if (reader->bitsUsed() >= limitBits){
+      done = true;
+      return 0;
+    }
+    return reader->get(1);
+  }
+  int children(int idx, int *out) const {
+    int i = idx / width;
+    int j = idx % width;
+    if (i < hL && j < wL){
+      if (levels == 0){
+        return 0;
+      }
+      out[0] = i * width + j + wL;
+      out[1] = (i + hL) * width + j;
+      out[2] = (i + hL) * width + j + wL;
+      return 3;
+    }
+    if (2 * i >= height || 2 * j >= width){
+      return 0;
+    }
+    out[0] = 2 * i * width + 2 * j;
+    out[1] = out[0] + 1;
+    out[2] = out[0] + width;
+    out[3] = out[2] + 1;
+    return 4;
+  }
+  //Largest descendant magnitude, computed in reverse raster order (children come later)
+  void computeTreeMax(int ch){
+    descMax[ch].assign(height * width, 0);
+    gdescMax[ch].assign(height * width, 0);
+    int kids[4];
+    for (int idx = height * width - 1; idx >= 0; idx--){
+      int count = children(idx, kids);
+      for (int k = 0; k < count; k++){
+        descMax[ch][idx] = max(descMax[ch][idx], max(mags[ch][kids[k]], descMax[ch][kids[k]]));
+        gdescMax[ch][idx] = max(gdescMax[ch][idx], descMax[ch][kids[k]]);
+      }
+    }
+  }
+  void markSignificant(int ch, int idx, int n){
+    int negative = code(writer ? (sgns[ch][idx] < 0) : 0);
+    if (done){
+      return;
+    }
+    if (!writer){
+      sgns[ch][idx] = negative ? -1 : 1;
+      rec[ch][idx] = sgns[ch][idx] * ((n == 0) ? 1.0 : 1.5 * (1 << n));
+    }
+    lsp[ch].push_back(idx);
+  }
+  void sortingPass(int ch, int n){
+    int threshold = 1 << n;
+    vector<int> stillInsignificant;
+    for (int idx : lip[ch]){
+      int significant = code(writer ? (mags[ch][idx] >= threshold) : 0);
+      if (done){
+        return;
+      }
+      if (significant){
+        markSignificant(ch, idx, n);
+        if (done){
+          return;
+        }
+      } else {
+        stillInsignificant.push_back(idx);
+      }
+    }
+    lip[ch].swap(stillInsignificant);
+
+    vector<pair<int, bool>> kept;
+    int kids[4];
+    int grandKids[4];
+    for (size_t k = 0; k < lis[ch].size(); k++){
+      pair<int, bool> entry = lis[ch][k];
+      int idx = entry.first;
+      if (entry.second){
+        //Type A: any descendant significant?
+        int significant = code(writer ? (descMax[ch][idx] >= threshold) : 0);
+        if (done){
+          return;
+        }
+        if (!significant){
+          kept.push_back(entry);
+          continue;
+        }
+        int count = children(idx, kids);
+        bool hasGrandKids = false;
+        for (int c = 0; c < count; c++){
+          int childSignificant = code(writer ? (mags[ch][kids[c]] >= threshold) : 0);
+          if (done){
+            return;
+          }
+          if (childSignificant){
+            markSignificant(ch, kids[c], n);
+            if (done){
+              return;
+            }
+          } else {
+            lip[ch].push_back(kids[c]);
+          }
+          hasGrandKids = hasGrandKids || children(kids[c], grandKids) > 0;
+        }
+        if (hasGrandKids){
+          lis[ch].push_back({idx, false});
+        }
+      } else {
+        //Type B: any grand descendant significant?
+        int significant = code(writer ? (gdescMax[ch][idx] >= threshold) : 0);
+        if (done){
+          return;
+        }
+        if (!significant){
+          kept.push_back(entry);
+          continue;
+        }
+        int count = children(idx, kids);
+        for (int c = 0; c < count; c++){
+          lis[ch].push_back({kids[c], true});
+        }
+      }
+    }
+    lis[ch].swap(kept);
+  }
+  void refinementPass(int ch, int n, size_t lspBefore){
+    for (size_t k = 0; k < lspBefore; k++){
+      int idx = lsp[ch][k];
+      int bit = code(writer ? ((mags[ch][idx] >> n) & 1) : 0);
+      if (done){
+        return;
+      }
+      if (!writer){
+        double offset = (n == 0) ? (bit ? 0.0 : -1.0) : (bit ? 0.5 : -0.5) * (1 << n);
+        rec[ch][idx] += sgns[ch][idx] * offset;
+      }
+    }
+  }
+};
+
+//Per coefficient weight: coarser levels count more, as in dwtLevelStep
+double embeddedWeight(int i, int j, int height, int width, int levels, Wavelet wavelet){
+  int level = 0;
+  while (level < levels && i < (height >> (level + 1)) && j < (width >> (level + 1))){
+    level++;
+  }
+  //level == levels is the LL band
+  double weight = (level == levels) ? (1 << levels) : (2 << level);
+  //Float wavelets keep 2 fractional bits, 5/3 is already integer
+  return (wavelet == CDF53) ? weight : weight * 4.0;
+}
+
+/**Encode three channels into an embedded .spt file image**/
+vector<unsigned char> encodeEmbedded(const vector<vector<double>> &red, const vector<vector<double>> &green, const vector<vector<double>> &blue, int imageWidth, int imageHeight, Wavelet wavelet){
+  TRACE_SCOPE("encode embedded");
+  //Edge pad so every tree is complete, the decoder crops back to the image size
+  int width = embeddedPaddedSize(imageWidth);
+  int height = embeddedPaddedSize(imageHeight);
+  int levels = embeddedLevels(height, width);
+  vector<vector<int>> mags(3, vector<int>(height * width));
+  vector<vector<int>> signs(3, vector<int>(height * width));
+  int maxMag = 0;
+  int ch = 0;
+  for (const vector<vector<double>> *plane : {&red, &green, &blue}){
+    vector<vector<double>> coeffs = padPlane(*plane, height, width);
+    outputDWT(coeffs, height, width, wavelet, levels);
+    for (int i = 0; i < height; i++){
+      for (int j = 0; j < width; j++){
+        long q = lround(coeffs[i][j] * embeddedWeight(i, j, height, width, levels, wavelet));
+        mags[ch][i * width + j] = static_cast<int>(min(labs(q), 1L << 30));
+        signs[ch][i * width + j] = (q < 0) ? -1 : 1;
+        maxMag = max(maxMag, mags[ch][i * width + j]);
+      }
+    }
+    ch++;
+  }
+  int topPlane = -1;
+  while ((maxMag >> (topPlane + 1)) > 0){
+    topPlane++;
+  }
+  vector<unsigned char> file = {'S', '5', '7', '6', EMBED_VERSION};
+  file.push_back(static_cast<unsigned char>(wavelet));
+  file.push_back(static_cast<unsigned char>(levels));
+  file.push_back(static_cast<unsigned char>(static_cast<signed char>(topPlane)));
+  writeU32(file, imageWidth);
+  writeU32(file, imageHeight);
+
+  SpihtCoder coder(height, width, levels);
+  coder.setChannels(mags, signs);
+  BitWriter writer;
+  coder.writer = &writer;
+  coder.run(topPlane, 3);
+  writer.flush();
+  file.insert(file.end(), writer.bytes.begin(), writer.bytes.end());
+  return file;
+}
+
+/**Decode the first `size` bytes of an embedded stream, false if the header is invalid**/
+bool decodeEmbedded(const unsigned char *data, size_t size, vector<vector<double>> &red, vector<vector<double>> &green, vector<vector<double>> &blue, int &width, int &height){
+  TRACE_SCOPE("decode embedded");
+  const size_t headerSize = 16;
+  if (size < headerSize || data[0] != 'S' || data[1] != '5' || data[2] != '7' || data[3] != '6' || data[4] != EMBED_VERSION){
+    return false;
+  }
+  Wavelet wavelet = static_cast<Wavelet>(data[5]);
+  int levels = data[6];
+  int topPlane = static_cast<signed char>(data[7]);
+  if (!streamSizeValid(readU32(data + 8), readU32(data + 12))){
+    return false;
+  }
+  width = readU32(data + 8);
+  height = readU32(data + 12);
+  int paddedWidth = embeddedPaddedSize(width);
+  int paddedHeight = embeddedPaddedSize(height);
+  if (wavelet > CDF97 || levels != embeddedLevels(paddedHeight, paddedWidth) || topPlane > 30){
+    return false;
+  }
+  SpihtCoder coder(paddedHeight, paddedWidth, levels);
+  BitReader reader(data + headerSize, size - headerSize);
+  coder.reader = &reader;
+  coder.limitBits = (size - headerSize) * 8;
+  coder.run(topPlane, 3);
+
+  int ch = 0;
+  for (vector<vector<double>> *plane : {&red, &green, &blue}){
+    vector<vector<double>> padded(paddedHeight, vector<double>(paddedWidth));
+    for (int i = 0; i < paddedHeight; i++){
+      for (int j = 0; j < paddedWidth; j++){
+        padded[i][j] = coder.rec[ch][i * paddedWidth + j] / embeddedWeight(i, j, paddedHeight, paddedWidth, levels, wavelet);
+      }
+    }
+    outputIDWT(padded, paddedHeight, paddedWidth, wavelet, levels);
+    *plane = cropPlane(padded, height, width);
+    ch++;
+  }
+  return true;
+}
+
+/**Read at most `bytes` bytes from the start of a file**/
+vector<unsigned char> readFilePrefix(string path, size_t bytes){
+  ifstream inputFile(path, ios::binary);
+  if (!inputFile.is_open()) {
+    cerr << "Error Opening File for Reading" << endl;
+    exit(1);
+  }
+  vector<unsigned char> data(bytes);
+  inputFile.read(reinterpret_cast<char *>(data.data()), bytes);
+  data.resize(inputFile.gcount());
+  return data;
+}
+
+/**Decode the first `bytes` bytes of an embedded stream file into out, or a malloc'd RGB buffer**/
+unsigned char *decodeEmbeddedFile(string streamPath, size_t bytes, unsigned char *out){
+  vector<unsigned char> data = readFilePrefix(streamPath, bytes);
+  ImagePlanes image;
+  if (!decodeEmbedded(data.data(), data.size(), image.red, image.green, image.blue, image.width, image.height)){
+    cerr << "Not a valid embedded stream" << endl;
+    exit(1);
+  }
+  return toInterleaved(image, out);
+}
+
+/**Headless --embed: write the embedded stream for an image**/
+void runEmbed(string imagePath, string outPath){
+  int width;
+  int height;
+  imageDimensions(imagePath, width, height);
+  ImagePlanes image = loadImage2D(imagePath, width, height);
+  auto start = chrono::steady_clock::now();
+  vector<unsigned char> file = encodeEmbedded(image.red, image.green, image.blue, width, height, dwtWavelet);
+  double encodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  ofstream outputFile(outPath, ios::binary);
+  if (!outputFile.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  outputFile.write(reinterpret_cast<const char *>(file.data()), file.size());
+  outputFile.close();
+  cout << "Embedded bytes: " << file.size() << endl;
+  cout << "Bits per pixel: " << file.size() * 8.0 / (width * height) << endl;
+  cout << "Encode MB/s: " << width * height * 3 / 1.0e6 / encodeSeconds << endl;
+}
+
+/**Headless --truncate: decode only the first `bytes` bytes of an embedded stream**/
+void runTruncate(string inPath, size_t bytes, string outPath){
+  vector<unsigned char> data = readFilePrefix(inPath, bytes);
+  vector<vector<double>> red;
+  vector<vector<double>> green;
+  vector<vector<double>> blue;
+  int width;
+  int height;
+  if (!decodeEmbedded(data.data(), data.size(), red, green, blue, width, height)){
+    cerr << "Not a valid embedded stream" << endl;
+    exit(1);
+  }
+  ofstream outputFile(outPath, ios::binary);
+  if (!outputFile.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  for (const vector<vector<double>> *plane : {&red, &green, &blue}){
+    vector<unsigned char> buf = to1D(*plane, height, width);
+    outputFile.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+  }
+  outputFile.close();
+  cout << "Decoded " << width << "x" << height << " from the first " << data.size() << " bytes" << endl;
+}
+
+/**
+ * Rate-distortion analysis (--rd).
+ * Sweeps n for DCT and DWT, reconstructs with readImageData and scores each
+ * result against the original. Reconstructions of different steps run on
+ * separate threads (readImageData only reads the coefficients it is given,
+ * its scratch planes are per thread).
+ **/
+/**Run body(begin, end) over [0, count) split across threads**/
+void parallelFor(int count, int threads, const function<void(int, int)> &body){
+  threads = max(1, min(threads, count));
+  if (threads == 1){
+    body(0, count);
+    return;
+  }
+  vector<thread> workers;
+  int chunk = (count + threads - 1) / threads;
+  for (int t = 0; t < threads; t++){
+    int begin = t * chunk;
+    int end = min(count, begin + chunk);
+    if (begin < end){
+      workers.emplace_back(body, begin, end);
+    }
+  }
+  for (thread &worker : workers){
+    worker.join();
+  }
+}
+
+/**MSE, PSNR and mean SSIM of two interleaved RGB images**/
+ImageMetrics computeMetrics(const unsigned char *ref, const unsigned char *test, int width, int height, int threads){
+  TRACE_SCOPE("metrics");
+  const double C1 = (0.01 * 255) * (0.01 * 255);
+  const double C2 = (0.03 * 255) * (0.03 * 255);
+  //SSIM on SSIM_WINDOW x SSIM_WINDOW windows every SSIM_STRIDE pixels
+  int windowRows = (height - SSIM_WINDOW) / SSIM_STRIDE + 1;
+  int windowCols = (width - SSIM_WINDOW) / SSIM_STRIDE + 1;
+  vector<double> rowError(height, 0.0);
+  vector<double> rowSSIM(max(windowRows, 0), 0.0);
+  parallelFor(height, threads, [&](int begin, int end) {
+    for (int y = begin; y < end; y++){
+      const unsigned char *a = ref + y * width * 3;
+      const unsigned char *b = test + y * width * 3;
+      //Integer accumulation keeps this loop vectorizable
+      long sum = 0;
+      for (int i = 0; i < width * 3; i++){
+        int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        sum += d * d;
+      }
+      rowError[y] = sum;
+    }
+  });
+  parallelFor(max(windowRows, 0), threads, [&](int begin, int end) {
+    const double count = SSIM_WINDOW * SSIM_WINDOW;
+    for (int wy = begin; wy < end; wy++){
+      double total = 0.0;
+      for (int wx = 0; wx < windowCols; wx++){
+        for (int c = 0; c < 3; c++){
+          double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+          for (int y = 0; y < SSIM_WINDOW; y++){
+            int offset = ((wy * SSIM_STRIDE + y) * width + wx * SSIM_STRIDE) * 3 + c;
+            for (int x = 0; x < SSIM_WINDOW; x++){
+              double va = ref[offset + x * 3];
+              double vb = test[offset + x * 3];
+              sumA += va;
+              sumB += vb;
+              sumAA += va * va;
+              sumBB += vb * vb;
+              sumAB += va * vb;
+            }
+          }
+          double meanA = sumA / count;
+          double meanB = sumB / count;
+          double varA = sumAA / count - meanA * meanA;
+          double varB = sumBB / count - meanB * meanB;
+          double cov = sumAB / count - meanA * meanB;
+          total += ((2 * meanA * meanB + C1) * (2 * cov + C2)) / ((meanA * meanA + meanB * meanB + C1) * (varA + varB + C2));
+        }
+      }
+      rowSSIM[wy] = total;
+    }
+  });
+  ImageMetrics metrics;
+  double error = 0.0;
+  for (double e : rowError){
+    error += e;
+  }
+  metrics.mse = error / (static_cast<double>(width) * height * 3);
+  metrics.psnr = (metrics.mse > 0) ? 10.0 * log10(255.0 * 255.0 / metrics.mse) : INFINITY;
+  double ssim = 0.0;
+  for (double s : rowSSIM){
+    ssim += s;
+  }
+  metrics.ssim = (windowRows > 0) ? ssim / (static_cast<double>(windowRows) * windowCols * 3) : 1.0;
+  return metrics;
+}
+
+/**One reconstruction in a sweep**/
+struct RDStep {
+  string method;
+  int step;
+  int n;
+  bool isDCT;
+  bool DWTB;
+};
+//Same steps as the GUI: "n" = powers of 4 up to every coefficient, "-1"/"-2" = progressive parts 1 and 2
+vector<RDStep> rdSteps(string mode, int total){
+  vector<RDStep> steps;
+  if (mode == "-1" || mode == "-2"){
+    for (int mult = 1; mult <= 64; mult++){
+      steps.push_back({"DCT", mult, static_cast<int>(static_cast<long>(total) * mult / 64), true, false});
+    }
+    if (mode == "-1"){
+      for (int k = 0; k < 10; k++){
+        steps.push_back({"DWT", k, max(total >> (2 * (9 - k)), 1), false, false});
+      }
+    } else {
+      for (int mult = 1; mult <= 64; mult++){
+        steps.push_back({"DWT", mult, static_cast<int>(static_cast<long>(total) * mult / 64), false, true});
+      }
+    }
+  } else {
+    int step = 0;
+    for (int n = max(total / 64, 1); n <= total; n *= 4){
+      steps.push_back({"DCT", step, n, true, false});
+      steps.push_back({"DWT", step, n, false, false});
+      step++;
+    }
+  }
+  return steps;
+}
+
+/**Headless --rd: write a CSV rate-distortion curve for every image**/
+void runRateDistortion(string csvPath, string mode, const vector<string> &imagePaths){
+  int threads = max(1u, thread::hardware_concurrency());
+  ofstream csv(csvPath);
+  if (!csv.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  csv << "image,method,step,n,mse,psnr,ssim" << endl;
+  auto start = chrono::steady_clock::now();
+  size_t rows = 0;
+  for (const string &imagePath : imagePaths){
+    int width;
+    int height;
+    imageDimensions(imagePath, width, height);
+    vector<RDStep> steps = rdSteps(mode, width * height);
+    ImagePlanes image = loadImage2D(imagePath, width, height);
+    ImageCoefficients coeffs;
+    encodeCoefficients(image, coeffs, true);
+    encodeCoefficients(image, coeffs, false);
+    unsigned char *original = transferInData(to1D(image.red, height, width), to1D(image.green, height, width), to1D(image.blue, height, width), width, height);
+    vector<ImageMetrics> results(steps.size());
+    parallelFor(steps.size(), threads, [&](int begin, int end) {
+      for (int i = begin; i < end; i++){
+        unsigned char *decoded = readImageData(coeffs, steps[i].n, steps[i].isDCT, steps[i].DWTB);
+        results[i] = computeMetrics(original, decoded, width, height, 1);
+        free(decoded);
+      }
+    });
+    for (size_t i = 0; i < steps.size(); i++){
+      csv << imagePath << "," << steps[i].method << "," << steps[i].step << "," << steps[i].n << ","
+          << results[i].mse << "," << results[i].psnr << "," << results[i].ssim << endl;
+    }
+    free(original);
+    rows += steps.size();
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "Wrote " << rows << " rows to " << csvPath << " in " << seconds << " s" << endl;
+}
+
+/**Headless --accuracy: full reconstructions in every precision against the double pipeline**/
+void runAccuracy(string imagePath){
+  int width;
+  int height;
+  imageDimensions(imagePath, width, height);
+  ImagePlanes image = loadImage2D(imagePath, width, height);
+  int threads = max(1u, thread::hardware_concurrency());
+  const Precision precisions[4] = {PRECISION_DOUBLE, PRECISION_FLOAT, PRECISION_FIXED32, PRECISION_FIXED16};
+  const string names[4] = {"double", "float", "fixed32", "fixed16"};
+  unsigned char *reference[2] = {NULL, NULL};
+  vector<string> rows;
+  for (int p = 0; p < 4; p++){
+    transformPrecision = precisions[p];
+    for (int method = 0; method < 2; method++){
+      bool isDCT = method == 0;
+      ImageCoefficients coeffs;
+      auto start = chrono::steady_clock::now();
+      encodeCoefficients(image, coeffs, isDCT);
+      double encodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      start = chrono::steady_clock::now();
+      unsigned char *decoded = readImageData(coeffs, width * height, isDCT, false);
+      double decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      if (p == 0){
+        reference[method] = decoded;
+      }
+      int maxError = 0;
+      for (int i = 0; i < width * height * 3; i++){
+        maxError = max(maxError, abs(decoded[i] - reference[method][i]));
+      }
+      ImageMetrics metrics = computeMetrics(reference[method], decoded, width, height, threads);
+      rows.push_back(names[p] + "," + (isDCT ? "DCT" : "DWT") + "," + to_string(encodeSeconds * 1000) + "," + to_string(decodeSeconds * 1000) + "," + to_string(maxError) + "," + to_string(metrics.psnr));
+      if (p != 0){
+        free(decoded);
+      }
+    }
+  }
+  free(reference[0]);
+  free(reference[1]);
+  cout << "precision,method,encode_ms,decode_ms,max_error,psnr_vs_double" << endl;
+  for (const string &row : rows){
+    cout << row << endl;
+  }
+}
+
+/**Headless --reconstruct: the two windows of the n mode as planar .rgb files**/
+void runReconstruct(string imagePath, int n, string outPrefix){
+  int width;
+  int height;
+  imageDimensions(imagePath, width, height);
+  if (n <= 0 || n > width * height){
+    cerr << "--reconstruct n should be between 1 and " << width * height << " for a " << width << "x" << height << " image" << endl;
+    exit(1);
+  }
+  ImagePlanes image = loadImage2D(imagePath, width, height);
+  ImageCoefficients coeffs;
+  encodeCoefficients(image, coeffs, true);
+  encodeCoefficients(image, coeffs, false);
+  for (int method = 0; method < 2; method++){
+    string outPath = outPrefix + (method == 0 ? "_dct.rgb" : "_dwt.rgb");
+    unsigned char *decoded = readImageData(coeffs, n, method == 0, false);
+    if (!writePlanarRGB(outPath, decoded, width, height)){
+      cerr << "Error Opening File for Writing" << endl;
+      exit(1);
+    }
+    free(decoded);
+    cout << "Wrote " << outPath << endl;
+  }
+}
+
+/**
+ * Video files for --export.
+ * Y4M frames are the JFIF YCbCr of the decoded RGB at full range, so
+ * players and ffmpeg read them directly; .rgb files are bare RGB24 frames
+ * (ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH).
+ **/
+VideoWriter::VideoWriter(string path, int width, int height, bool y4m)
+    : file(path, ios::binary), width(width), height(height), y4m(y4m) {
+  if (!file.is_open()) {
+    cerr << "Error Opening File for Writing" << endl;
+    exit(1);
+  }
+  if (y4m){
+    file << "YUV4MPEG2 W" << width << " H" << height << " F" << PROGRESSIVE_FPS << ":1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+    planes.resize(static_cast<size_t>(width) * height * 3);
+  }
+}
+void VideoWriter::writeFrame(const unsigned char *rgb){
+  TRACE_SCOPE("video frame");
+  size_t area = static_cast<size_t>(width) * height;
+  if (y4m){
+    for (size_t i = 0; i < area; i++){
+      int y;
+      int cb;
+      int cr;
+      rgbToYCbCr(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2], y, cb, cr);
+      planes[i] = y;
+      planes[area + i] = cb;
+      planes[2 * area + i] = cr;
+    }
+    file << "FRAME\n";
+    file.write(reinterpret_cast<const char *>(planes.data()), planes.size());
+  } else {
+    file.write(reinterpret_cast<const char *>(rgb), area * 3);
+  }
+  frames++;
+}
+
+/**
+ * Headless --export: the GUI's progressive sequences as video files.
+ * One decode worker per method feeds a FrameQueue (decode stage) and this
+ * thread writes the DCT, DWT and side by side files as frames arrive (write
+ * stage), so decoding never waits on a window or a timer. When one method
+ * has fewer steps (part 1: 10 DWT steps against 64 DCT steps), the side by
+ * side file holds its last frame.
+ **/
+void runExport(string imagePath, string outPrefix, string mode, bool y4m){
+  int width;
+  int height;
+  imageDimensions(imagePath, width, height);
+  ImagePlanes image = loadImage2D(imagePath, width, height);
+  ImageCoefficients coeffs;
+  encodeCoefficients(image, coeffs, true);
+  encodeCoefficients(image, coeffs, false);
+  vector<RDStep> steps = rdSteps(mode, width * height);
+  vector<RDStep> methodSteps[2];
+  for (const RDStep &step : steps){
+    methodSteps[step.isDCT ? 0 : 1].push_back(step);
+  }
+
+  string extension = y4m ? ".y4m" : ".rgb";
+  VideoWriter writers[3] = {
+    VideoWriter(outPrefix + "_dct" + extension, width, height, y4m),
+    VideoWriter(outPrefix + "_dwt" + extension, width, height, y4m),
+    VideoWriter(outPrefix + "_side" + extension, 2 * width, height, y4m)
+  };
+  auto start = chrono::steady_clock::now();
+  //Decode stage
+  FrameQueue queues[2] = {FrameQueue(PROGRESSIVE_QUEUE_DEPTH), FrameQueue(PROGRESSIVE_QUEUE_DEPTH)};
+  double decodeSeconds[2] = {0.0, 0.0};
+  vector<thread> decoders;
+  for (int m = 0; m < 2; m++){
+    decoders.emplace_back([&, m]() {
+      for (const RDStep &step : methodSteps[m]){
+        auto decodeStart = chrono::steady_clock::now();
+        unsigned char *data = readImageData(coeffs, step.n, step.isDCT, step.DWTB);
+        decodeSeconds[m] += chrono::duration<double>(chrono::steady_clock::now() - decodeStart).count();
+        if (!queues[m].push(DecodedFrame{data, step.method + " n == " + to_string(step.n)})){
+          return;
+        }
+      }
+      queues[m].finish();
+    });
+  }
+  //Write stage
+  double writeSeconds = 0.0;
+  unsigned char *last[2] = {NULL, NULL};
+  bool open[2] = {true, true};
+  vector<unsigned char> side(static_cast<size_t>(width) * height * 6);
+  size_t rowBytes = static_cast<size_t>(width) * 3;
+  while (open[0] || open[1]){
+    bool fresh = false;
+    for (int m = 0; m < 2; m++){
+      DecodedFrame frame;
+      if (open[m] && queues[m].pop(frame)){
+        auto writeStart = chrono::steady_clock::now();
+        writers[m].writeFrame(frame.data);
+        writeSeconds += chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+        free(last[m]);
+        last[m] = frame.data;
+        fresh = true;
+      } else {
+        open[m] = false;
+      }
+    }
+    if (fresh && last[0] != NULL && last[1] != NULL){
+      auto writeStart = chrono::steady_clock::now();
+      for (int y = 0; y < height; y++){
+        copy(last[0] + y * rowBytes, last[0] + (y + 1) * rowBytes, side.begin() + 2 * y * rowBytes);
+        copy(last[1] + y * rowBytes, last[1] + (y + 1) * rowBytes, side.begin() + (2 * y + 1) * rowBytes);
+      }
+      writers[2].writeFrame(side.data());
+      writeSeconds += chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+    }
+  }
+  for (thread &decoder : decoders){
+    decoder.join();
+  }
+  free(last[0]);
+  free(last[1]);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "Wrote " << writers[0].frames << " DCT, " << writers[1].frames << " DWT and " << writers[2].frames
+       << " side by side frames to " << outPrefix << "_{dct,dwt,side}" << extension << endl;
+  cout << "Export " << seconds << " s, decode DCT " << decodeSeconds[0] << " s, decode DWT " << decodeSeconds[1]
+       << " s, write " << writeSeconds << " s" << endl;
+}
+
+
+/** Utility function to read image data */
+unsigned char *readImageData(const ImageCoefficients &coeffs, int n, bool isDCT, bool DWTB, unsigned char *out) {
+  TRACE_SCOPE("reconstruct");
+  if (n <= 0){
+    cout << "you shouldn't be here!" << endl;
+    return NULL;
+  }
+  TRACE_COUNTER("coefficients", n);
+  //Temporaries come from this thread's arena, reused from the previous step
+  thread_local DecodeArena arena;
+  arena.reset();
+  ImagePlanes &image = arena.image;
+  image.width = coeffs.width;
+  image.height = coeffs.height;
+  image.chroma = coeffs.chroma;
+  switch (coeffs.precision){
+    case PRECISION_DOUBLE: decodePlanes(coeffs.doubles, image, n, isDCT, DWTB, arena); break;
+    case PRECISION_FLOAT: decodePlanes(coeffs.floats, image, n, isDCT, DWTB, arena); break;
+    case PRECISION_FIXED32: decodePlanes(coeffs.fixed32, image, n, isDCT, DWTB, arena); break;
+    case PRECISION_FIXED16: decodePlanes(coeffs.fixed16, image, n, isDCT, DWTB, arena); break;
+  }
+  if (compressionLog){
+    cout << (isDCT ? "Finished IDCT Decoding" : "Finished IDWT Decoding") << endl;
+  }
+  if (image.chroma != CHROMA_RGB){
+    toRGB(image);
+  }
+
+  //Finish
+  if (compressionLog){
+    cout << (isDCT ? "DONE DCT WITH n = " : "DONE DWT WITH n = ") << n << endl;
+  }
+  return toInterleaved(image, out);
+}
+template <typename T> void decodePlanes(const CoefficientPlanes<T> &planes, ImagePlanes &image, int n, bool isDCT, bool DWTB, DecodeArena &arena){
+  const vector<vector<T>> *DCTPlanes[3] = {&planes.DCTRed, &planes.DCTGreen, &planes.DCTBlue};
+  const vector<vector<T>> *DWTPlanes[3] = {&planes.DWTRed, &planes.DWTGreen, &planes.DWTBlue};
+  vector<vector<double>> *channels[3] = {&image.red, &image.green, &image.blue};
+  int planeWidths[3];
+  int planeHeights[3];
+  long keep[3];
+  for (int c = 0; c < 3; c++){
+    planeSize(image.chroma, c, image.width, image.height, planeWidths[c], planeHeights[c]);
+    //n counts luma coefficients, smaller chroma planes keep the same fraction of theirs
+    keep[c] = lround(static_cast<double>(n) * planeWidths[c] * planeHeights[c] / (static_cast<double>(image.width) * image.height));
+  }
+  if (coeffSelection != SELECT_POSITION){
+    //Largest magnitudes anywhere in the plane (or image), then a full inverse transform
+    const vector<vector<T>> *const *sources = isDCT ? DCTPlanes : DWTPlanes;
+    SparsePlane<T> *sparse = selectLargest(sources, keep, coeffSelection == SELECT_JOINT, isDCT, arena);
+    if (compressionLog){
+      cout << "Finished Coefficient Selection" << endl;
+    }
+    for (int c = 0; c < 3; c++){
+      vector<vector<T>> &dense = arena.plane<T>(sparse[c].height, sparse[c].width);
+      scatterPlane(sparse[c], dense);
+      if (isDCT){
+        vector<vector<T>> &samples = arena.plane<T>(planeHeights[c], planeWidths[c]);
+        idctPlane(dense, planeHeights[c], planeWidths[c], planeWidths[c] * planeHeights[c], samples);
+        fromSamples(samples, *channels[c]);
+      } else {
+        int nonzeroRows = 0;
+        int nonzeroCols = 0;
+        for (uint32_t index : sparse[c].index){
+          nonzeroRows = max(nonzeroRows, static_cast<int>(index / sparse[c].width) + 1);
+          nonzeroCols = max(nonzeroCols, static_cast<int>(index % sparse[c].width) + 1);
+        }
+        outputIDWT(dense, planeHeights[c], planeWidths[c], dwtWavelet, dwtLevels, nonzeroRows, nonzeroCols);
+        fromSamples(dense, *channels[c]);
+      }
+    }
+    return;
+  }
+  for (int c = 0; c < 3; c++){
+    int planeWidth = planeWidths[c];
+    int planeHeight = planeHeights[c];
+    int planeN = keep[c];
+    vector<vector<T>> &samples = arena.plane<T>(planeHeight, planeWidth);
+    if (isDCT){
+      idctPlane(*DCTPlanes[c], planeHeight, planeWidth, planeN, samples);
+    } else {
+      idwtPlane(*DWTPlanes[c], planeHeight, planeWidth, planeN, DWTB, samples);
+    }
+    fromSamples(samples, *channels[c]);
+  }
+}
+
+/** Function to get the DWT level of every row (or column), levelCount = low pass */
+void dwtAxisLevels(int size, int levelCount, vector<int> &levels){
+  levels.assign(size, levelCount);
+  for (int level = 0; level < levelCount; level++){
+    int low = (size + 1) / 2;
+    fill(levels.begin() + low, levels.begin() + size, level);
+    size = low;
+  }
+}
+
+/** Function to select the largest magnitude coefficients with nth_element (linear time) */
+template <typename T> SparsePlane<T> *selectLargest(const vector<vector<T>> *const planes[3], const long keep[3], bool joint, bool isDCT, DecodeArena &arena){
+  TRACE_SCOPE("select");
+  SparsePlane<T> *out = arena.sparse<T>();
+  //DWT level of every row and column, the DCT is orthonormal and needs no weight
+  int levelCounts[3] = {0, 0, 0};
+  for (int c = 0; c < 3; c++){
+    out[c].height = planes[c]->size();
+    out[c].width = (*planes[c])[0].size();
+    out[c].index.clear();
+    out[c].value.clear();
+    if (!isDCT){
+      levelCounts[c] = dwtLevelCount(out[c].height, out[c].width, dwtLevels);
+      dwtAxisLevels(out[c].height, levelCounts[c], arena.rowLevels[c]);
+      dwtAxisLevels(out[c].width, levelCounts[c], arena.colLevels[c]);
+    }
+  }
+  //Avg/diff scaling: a level L detail coefficient spans 2^(L+1) pixels per side, LL spans 2^levels
+  auto score = [&](int c, int i, int j, T v) {
+    float magnitude = static_cast<float>(SampleTraits<T>::toDouble(v < 0 ? -v : v));
+    if (isDCT){
+      return magnitude;
+    }
+    int level = min(arena.rowLevels[c][i], arena.colLevels[c][j]);
+    return magnitude * ((level == levelCounts[c]) ? (1 << level) : (2 << level));
+  };
+  //Joint selection ranks every plane together as one group, otherwise each plane on its own
+  int groupSize = joint ? 3 : 1;
+  for (int first = 0; first < 3; first += groupSize){
+    long count = 0;
+    vector<float> &scores = arena.scores;
+    scores.clear();
+    for (int c = first; c < first + groupSize; c++){
+      count += keep[c];
+      for (int i = 0; i < out[c].height; i++){
+        const vector<T> &row = (*planes[c])[i];
+        for (int j = 0; j < out[c].width; j++){
+          scores.push_back(score(c, i, j, row[j]));
+        }
+      }
+    }
+    if (count <= 0){
+      continue;
+    }
+    count = min(count, static_cast<long>(scores.size()));
+    //Everything above threshold is kept, ties at threshold fill the rest in scan order
+    auto nth = scores.begin() + (scores.size() - count);
+    nth_element(scores.begin(), nth, scores.end());
+    float threshold = *nth;
+    long ties = count - count_if(nth, scores.end(), [threshold](float v) { return v > threshold; });
+    for (int c = first; c < first + groupSize; c++){
+      SparsePlane<T> &sparse = out[c];
+      for (int i = 0; i < sparse.height; i++){
+        const vector<T> &row = (*planes[c])[i];
+        for (int j = 0; j < sparse.width; j++){
+          float value = score(c, i, j, row[j]);
+          if (value > threshold || (value == threshold && ties > 0)){
+            if (value == threshold){
+              ties--;
+            }
+            sparse.index.push_back(i * sparse.width + j);
+            sparse.value.push_back(row[j]);
+          }
+        }
+      }
+    }
+  }
+  return out;
+}
+/** Function to write a sparse plane into a zero filled dense one */
+template <typename T> void scatterPlane(const SparsePlane<T> &sparse, vector<vector<T>> &plane){
+  for (size_t k = 0; k < sparse.index.size(); k++){
+    plane[sparse.index[k] / sparse.width][sparse.index[k] % sparse.width] = sparse.value[k];
+  }
+}
+
+/** Function to IDCT a plane keeping the first zigzag coefficients of every block (n in total) */
+template <typename T> void idctPlane(const vector<vector<T>> &coeffPlane, int height, int width, int n, vector<vector<T>> &plane){
+  TRACE_SCOPE("idct");
+  //Part 2 - Decode it
+  //Keep the first m zigzag coefficients of every block, applied while the IDCT loads the block
+  int m = clamp(static_cast<int>(lround(n * 64.0 / (static_cast<double>(width) * height))), 0, 64);
+  uint64_t mask = ZIGZAG.mask[m];
+  TRACE_COUNTER("zigzag coefficients per block", m);
+  const auto &cosTable = cosineTable<T>();
+  //IDCT, padding pixels past the plane edge are dropped
+  T chunk[64];
+  for (int i = 0; i < height; i+=8){
+    for (int j = 0; j < width; j+=8){
+      outputIDCTBlock(coeffPlane, j, i, cosTable, cosTable, chunk, mask);
+      for (int y = 0; y < min(8, height - i); y++){
+        copy(chunk + y * 8, chunk + y * 8 + min(8, width - j), plane[i + y].begin() + j);
+      }
+    }
+  }
+}
+
+/** Function to IDWT a plane keeping n of its coefficients */
+template <typename T> void idwtPlane(const vector<vector<T>> &coeffPlane, int height, int width, int n, bool DWTB, vector<vector<T>> &plane){
+  TRACE_SCOPE("idwt plane");
+  //Corner holding every kept coefficient, the IDWT skips what lies outside
+  int nonzeroRows = 0;
+  int nonzeroCols = 0;
+  if (!DWTB){
+  //Part 2 - Decode it
+  //Top-left corner with the plane's aspect ratio holding n coefficients (sqrt(n) x sqrt(n) at 512x512)
+  double fraction = sqrt(min(1.0, n / (static_cast<double>(width) * height)));
+  int coeffRows = min(height, static_cast<int>(lround(height * fraction)));
+  int coeffCols = min(width, static_cast<int>(lround(width * fraction)));
+  for (int i = 0; i < coeffRows; i++){
+    copy(coeffPlane[i].begin(), coeffPlane[i].begin() + coeffCols, plane[i].begin());
+  }
+  nonzeroRows = coeffRows;
+  nonzeroCols = coeffCols;
+  }else {
+    static const int coeffOrder[64][2] {
+      {0,0},{0,1},{1,0},{1,1},{0,2},{0,3},{1,2},{1,3},{2,0},{2,1},{3,0},{3,1},{2,2},{2,3},{3,2},{3,3},
+      {0,4},{0,5},{0,6},{0,7},{1,4},{1,5},{1,6},{1,7},{2,4},{2,5},{2,6},{2,7},{3,4},{3,5},{3,6},{3,7},
+      {4,0},{4,1},{4,2},{4,3},{5,0},{5,1},{5,2},{5,3},{6,0},{6,1},{6,2},{6,3},{7,0},{7,1},{7,2},{7,3},
+      {4,4},{4,5},{4,6},{4,7},{5,4},{5,5},{5,6},{5,7},{6,4},{6,5},{6,6},{6,7},{7,4},{7,5},{7,6},{7,7}
+    };
+    //The plane is split into an 8x8 grid of cells (64x64 at 512x512)
+    int m = clamp(static_cast<int>(lround(n * 64.0 / (static_cast<double>(width) * height))), 0, 64);
+    int cellHeight = (height + 7) / 8;
+    int cellWidth = (width + 7) / 8;
+    for (int block = 0; block < m; block++){
+      int row = coeffOrder[block][0];
+      int col = coeffOrder[block][1];
+      int colEnd = min(width, (col + 1) * cellWidth);
+      for (int i = row * cellHeight; i < min(height, (row + 1) * cellHeight); i++){
+        if (col * cellWidth < colEnd){
+          copy(coeffPlane[i].begin() + col * cellWidth, coeffPlane[i].begin() + colEnd, plane[i].begin() + col * cellWidth);
+        }
+      }
+      nonzeroRows = max(nonzeroRows, min(height, (row + 1) * cellHeight));
+      nonzeroCols = max(nonzeroCols, colEnd);
+    }
+  }
+  //IDWT (in place)
+  outputIDWT(plane, height, width, dwtWavelet, dwtLevels, nonzeroRows, nonzeroCols);
+}
@@ -0,0 +1,460 @@
+#pragma once
+/**
+ * GUI-free core of the DCT vs DWT comparison: transforms, coefficient
+ * selection, codecs and the headless modes. Linked by the wxWidgets front
+ * end (Main.cpp) and the command line front end (Cli.cpp).
+ */
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <tuple>
+#include "../common/ImageCore.h"
+
+/** Declarations*/
+//Wavelet filters for the lifting DWT
+enum Wavelet { HAAR, CDF53, CDF97 };
+//Columns lifted together so the column pass walks rows sequentially
+const int DWT_COL_BLOCK = 8;
+//Color front end: RGB as is, or YCbCr with full, half horizontal or half both ways chroma
+enum ChromaFormat { CHROMA_RGB, CHROMA_444, CHROMA_422, CHROMA_420 };
+//Which n coefficients are kept: by position (zigzag count / DWT corner) or the largest magnitudes
+enum CoeffSelection { SELECT_POSITION, SELECT_CHANNEL, SELECT_JOINT };
+
+/**
+ * Sample types for the transform pipeline.
+ * double is the reference, float halves the memory traffic and doubles the
+ * SIMD width, Fixed32 / Fixed16 hold integers with FRAC fraction bits.
+ * Constants (cosines, lifting coefficients) of the integer types are
+ * COEF_BITS fixed point and every product is rounded back to FRAC bits.
+ **/
+enum Precision { PRECISION_DOUBLE, PRECISION_FLOAT, PRECISION_FIXED32, PRECISION_FIXED16 };
+using Fixed32 = int32_t;
+using Fixed16 = int16_t;
+const int COEF_BITS = 14;
+template <typename T> struct SampleTraits {
+  //Accumulator and constant types
+  using Work = T;
+  using Coef = T;
+  static T fromDouble(double v) { return static_cast<T>(v); }
+  static double toDouble(T v) { return v; }
+  static Coef coef(double c) { return static_cast<Coef>(c); }
+  static Work mul(Work a, Coef c) { return a * c; }
+  //floor(a / 2^shift) of a value in pixel units
+  static Work floorShift(Work a, int shift) { return std::floor(a / static_cast<Work>(1 << shift)); }
+  static T narrow(Work a) { return a; }
+};
+template <typename Raw, typename Wide, int FRAC> struct FixedTraits {
+  using Work = Wide;
+  using Coef = int32_t;
+  static Raw fromDouble(double v) { return static_cast<Raw>(std::lround(v * (1 << FRAC))); }
+  static double toDouble(Wide v) { return v / static_cast<double>(1 << FRAC); }
+  static Coef coef(double c) { return static_cast<Coef>(std::lround(c * (1 << COEF_BITS))); }
+  static Work mul(Work a, Coef c) { return (a * c + (Wide(1) << (COEF_BITS - 1))) >> COEF_BITS; }
+  static Work floorShift(Work a, int shift) { return (a >> (FRAC + shift)) << FRAC; }
+  static Raw narrow(Work a) { return static_cast<Raw>(a); }
+};
+//Range of DCT / DWT values is about +-4096, which sets FRAC
+template <> struct SampleTraits<Fixed32> : FixedTraits<Fixed32, int64_t, 16> {};
+template <> struct SampleTraits<Fixed16> : FixedTraits<Fixed16, int32_t, 3> {};
+
+/**
+ * Zigzag tables built at compile time.
+ * index[k] = row * 8 + col of the k-th zigzag coefficient,
+ * mask[m] = bit (row * 8 + col) set for the first m zigzag coefficients.
+ **/
+struct ZigzagTables {
+  int index[64];
+  uint64_t mask[65];
+};
+constexpr ZigzagTables makeZigzagTables(){
+  ZigzagTables tables{};
+  int row = 0;
+  int col = 0;
+  bool up = true;
+  for (int k = 0; k < 64; k++){
+    tables.index[k] = row * 8 + col;
+    tables.mask[k + 1] = tables.mask[k] | (uint64_t(1) << (row * 8 + col));
+    if (up){
+      if (row == 0 || col == 7){
+        up = false;
+        if (col == 7){
+          row += 1;
+        } else {
+          col += 1;
+        }
+      } else {
+        row -= 1;
+        col += 1;
+      }
+    } else {
+      if (row == 7 || col == 0){
+        up = true;
+        if (row == 7){
+          col += 1;
+        } else {
+          row += 1;
+        }
+      } else {
+        row += 1;
+        col -= 1;
+      }
+    }
+  }
+  return tables;
+}
+constexpr ZigzagTables ZIGZAG = makeZigzagTables();
+static_assert(ZIGZAG.index[2] == 8 && ZIGZAG.index[63] == 63, "zigzag order");
+const uint64_t ALL_COEFFS = ~uint64_t(0);
+extern std::vector<std::vector<double>> cosTableU;
+extern std::vector<std::vector<double>> cosTableV;
+extern Wavelet dwtWavelet;
+//DWT decomposition levels, -1 = recurse until a side reaches 1
+extern int dwtLevels;
+//Image size from --size, 0 = square image inferred from the file size
+extern int imageWidthOption;
+extern int imageHeightOption;
+extern ChromaFormat chromaFormat;
+//Sample type of the viewer and --rd pipeline, the codecs always use double
+extern Precision transformPrecision;
+extern CoeffSelection coeffSelection;
+//Per encode / decode progress messages, off in the headless modes and the job server (they run many in parallel)
+extern bool compressionLog;
+
+/** Three channels of one image */
+struct ImagePlanes {
+  int width = 0;
+  int height = 0;
+  //Not CHROMA_RGB: red/green/blue hold Y/Cb/Cr, Cb and Cr at chroma resolution
+  ChromaFormat chroma = CHROMA_RGB;
+  std::vector<std::vector<double>> red;
+  std::vector<std::vector<double>> green;
+  std::vector<std::vector<double>> blue;
+};
+/** Coefficient planes in one sample type */
+template <typename T> struct CoefficientPlanes {
+  std::vector<std::vector<T>> DCTRed;
+  std::vector<std::vector<T>> DCTGreen;
+  std::vector<std::vector<T>> DCTBlue;
+  std::vector<std::vector<T>> DWTRed;
+  std::vector<std::vector<T>> DWTGreen;
+  std::vector<std::vector<T>> DWTBlue;
+};
+/** Coefficients kept by top-n selection, index = row * width + column */
+template <typename T> struct SparsePlane {
+  int height = 0;
+  int width = 0;
+  std::vector<uint32_t> index;
+  std::vector<T> value;
+};
+/** Transform coefficients of one image, sized when the image is encoded */
+struct ImageCoefficients {
+  int width = 0;
+  int height = 0;
+  //Channel layout, see ImagePlanes. DCT planes are edge padded to multiples of 8
+  ChromaFormat chroma = CHROMA_RGB;
+  //Only the planes of this precision are filled
+  Precision precision = PRECISION_DOUBLE;
+  CoefficientPlanes<double> doubles;
+  CoefficientPlanes<float> floats;
+  CoefficientPlanes<Fixed32> fixed32;
+  CoefficientPlanes<Fixed16> fixed16;
+};
+
+/**
+ * Scratch memory of one decode step (readImageData).
+ * Every temporary plane of a step comes from here. reset() at the start of
+ * the next step hands the same planes out again and rows keep their
+ * capacity, so once the first step has sized them a progressive run
+ * allocates nothing but the output frame. One arena per decode thread.
+ **/
+class DecodeArena {
+ public:
+  //Next free height x width plane of T, zero filled
+  template <typename T> std::vector<std::vector<T>> &plane(int height, int width);
+  //Hand every plane out again, the memory is kept
+  void reset();
+  //Channels of the step being decoded
+  ImagePlanes image;
+  //Top-n selection of the step, one sparse plane per channel
+  template <typename T> SparsePlane<T> *sparse() { return pool<T>().sparse; }
+  //Selection scores and DWT levels of every row and column, refilled every step
+  std::vector<float> scores;
+  std::vector<int> rowLevels[3];
+  std::vector<int> colLevels[3];
+
+ private:
+  //A deque never moves the planes already handed out when it grows
+  template <typename T> struct Pool {
+    std::deque<std::vector<std::vector<T>>> planes;
+    size_t used = 0;
+    SparsePlane<T> sparse[3];
+  };
+  template <typename T> Pool<T> &pool() { return std::get<Pool<T>>(pools); }
+  std::tuple<Pool<double>, Pool<float>, Pool<Fixed32>, Pool<Fixed16>> pools;
+};
+
+/**
+ * Progressive playback.
+ * A worker thread decodes each step into an RGB buffer taken from the
+ * FrameQueue and pushes it; the frame's wxTimer pops one buffer per tick,
+ * uploads it and hands it back with recycle(), so the same few buffers go
+ * round instead of one malloc per step.
+ */
+const int PROGRESSIVE_FPS = 8;
+const size_t PROGRESSIVE_QUEUE_DEPTH = 8;
+struct DecodedFrame {
+  //malloc'd RGB buffer, owned by whoever holds the frame
+  unsigned char *data;
+  std::string label;
+};
+//out = RGB buffer of the image size to decode into
+using ProgressiveStep = std::function<DecodedFrame(const ImageCoefficients &, unsigned char *out)>;
+
+/** Bounded single producer / single consumer queue of decoded frames */
+class FrameQueue {
+ public:
+  explicit FrameQueue(size_t capacity) : capacity(capacity) {}
+  ~FrameQueue();
+  //Blocks while full, false if the consumer cancelled
+  bool push(DecodedFrame frame);
+  //Never blocks, used from the GUI thread
+  bool tryPop(DecodedFrame &frame);
+  //Blocks until a frame is ready, false once the producer finished and the queue is empty
+  bool pop(DecodedFrame &frame);
+  //Producer is done, the consumer drains what is left
+  void finish();
+  //Consumer is gone, wakes and stops the producer
+  void cancel();
+  bool drained();
+  //A recycled frame buffer of bytes bytes, or a new one
+  unsigned char *buffer(size_t bytes);
+  //Give a shown frame's buffer back for the producer to reuse
+  void recycle(unsigned char *data);
+
+ private:
+  std::mutex lock;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+  std::deque<DecodedFrame> frames;
+  std::vector<unsigned char *> spare;
+  size_t capacity;
+  bool finished = false;
+  bool cancelled = false;
+};
+
+/** Utility function to read image data, into out when given (width * height * 3 bytes) or a malloc'd buffer */
+unsigned char *readImageData(const ImageCoefficients &coeffs, int n, bool isDCT, bool DWTB, unsigned char *out = nullptr);
+//Width and height of an image file (--size or a square inferred from the file size)
+void imageDimensions(std::string imagePath, int &width, int &height);
+//Read planar .rgb file into three planes
+ImagePlanes loadImage2D(std::string imagePath, int width, int height);
+//Edge replicate a plane up to paddedHeight x paddedWidth
+template <typename T> std::vector<std::vector<T>> padPlane(const std::vector<std::vector<T>> &plane, int paddedHeight, int paddedWidth);
+template <typename T> std::vector<std::vector<T>> cropPlane(const std::vector<std::vector<T>> &plane, int height, int width);
+//Fill the DCT or DWT planes of coeffs from an image, in transformPrecision
+void encodeCoefficients(const ImagePlanes &image, ImageCoefficients &coeffs, bool isDCT);
+template <typename T> void encodePlanes(const ImagePlanes &planes, CoefficientPlanes<T> &out, bool isDCT);
+template <typename T> void decodePlanes(const CoefficientPlanes<T> &planes, ImagePlanes &image, int n, bool isDCT, bool DWTB, DecodeArena &arena);
+//Per plane transforms, the inverse ones keep n of the plane's coefficients and
+//write into plane (height x width, zero filled for the IDWT)
+template <typename T> std::vector<std::vector<T>> dctPlane(const std::vector<std::vector<T>> &plane, int height, int width);
+template <typename T> void idctPlane(const std::vector<std::vector<T>> &coeffPlane, int height, int width, int n, std::vector<std::vector<T>> &plane);
+template <typename T> void idwtPlane(const std::vector<std::vector<T>> &coeffPlane, int height, int width, int n, bool DWTB, std::vector<std::vector<T>> &plane);
+//Keep the keep[c] largest magnitudes of every plane, or their sum over all planes when joint.
+//DWT magnitudes are weighted by their subband's basis norm so they rank like DCT ones
+//The three sparse planes and the scores are the arena's
+template <typename T> SparsePlane<T> *selectLargest(const std::vector<std::vector<T>> *const planes[3], const long keep[3], bool joint, bool isDCT, DecodeArena &arena);
+void dwtAxisLevels(int size, int levelCount, std::vector<int> &levels);
+//Write the sparse coefficients into plane (zero filled, sparse.height x sparse.width)
+template <typename T> void scatterPlane(const SparsePlane<T> &sparse, std::vector<std::vector<T>> &plane);
+//Conversion between double planes and the sample type T
+template <typename T> std::vector<std::vector<T>> toSamples(const std::vector<std::vector<double>> &plane);
+template <typename T> void fromSamples(const std::vector<std::vector<T>> &plane, std::vector<std::vector<double>> &out);
+//Size of channel 0 - 2 of a width x height image
+void planeSize(ChromaFormat format, int channel, int width, int height, int &planeWidth, int &planeHeight);
+//Fixed point RGB <-> YCbCr with chroma decimation / upsampling
+ImagePlanes toYCbCr(const ImagePlanes &image, ChromaFormat format);
+void toRGB(ImagePlanes &image);
+std::vector<std::vector<double>> downsamplePlane(const std::vector<std::vector<double>> &plane, int factorY, int factorX);
+std::vector<std::vector<double>> upsamplePlane(const std::vector<std::vector<double>> &plane, int height, int width, int factorY, int factorX);
+//2D output to 1D stream
+std::vector<unsigned char> to1D(const std::vector<std::vector<double>> &output2D, int height, int width);
+//RGB planes straight to an interleaved buffer (to1D + transferInData without the 1D copies), malloc'd unless out is given
+unsigned char *toInterleaved(const ImagePlanes &image, unsigned char *out = nullptr);
+//Function for CosineTables
+std::vector<std::vector<double>> outputCosineTableV(int sizeY, int sizeX);
+std::vector<std::vector<double>> outputCosineTableU(int sizeY, int sizeX);
+//Cosine table in the constant type of T
+template <typename T> const std::vector<std::vector<typename SampleTraits<T>::Coef>> &cosineTable();
+template <typename T> std::vector<std::vector<T>> outputDCTBlock(const std::vector<std::vector<T>> &ogBlock, int offsetX, int offsetY, const std::vector<std::vector<typename SampleTraits<T>::Coef>> &cosTableU, const std::vector<std::vector<typename SampleTraits<T>::Coef>> &cosTableV);
+//block = 64 output pixels in raster order
+template <typename T> void outputIDCTBlock(const std::vector<std::vector<T>> &ogBlock, int offsetX, int offsetY, const std::vector<std::vector<typename SampleTraits<T>::Coef>> &cosTableU, const std::vector<std::vector<typename SampleTraits<T>::Coef>> &cosTableV, T *block, uint64_t mask = ALL_COEFFS);
+template <typename T> void outputDWT(std::vector<std::vector<T>> &block, int height, int width, Wavelet wavelet = HAAR, int levels = -1);
+//nonzeroRows x nonzeroCols = top-left corner holding every nonzero coefficient (-1 = whole plane)
+template <typename T> void outputIDWT(std::vector<std::vector<T>> &block, int height, int width, Wavelet wavelet = HAAR, int levels = -1, int nonzeroRows = -1, int nonzeroCols = -1);
+int dwtLevelCount(int height, int width, int levels);
+
+/**Compressed bitstream (.cmp)**/
+const unsigned char CODEC_VERSION = 4;
+const int HUFF_LOOKUP_BITS = 9;
+const unsigned char HUFF_EOB = 0x00;
+const unsigned char HUFF_ZRL = 0xF0;
+const int CODEC_MAX_SIZE = 15;
+//Largest image a stream header may declare, so a corrupt header cannot ask for gigabytes
+const int CODEC_MAX_DIMENSION = 1 << 15;
+const size_t CODEC_MAX_PIXELS = size_t(1) << 26;
+//JPEG (Annex K) luminance quantization table, quality 50
+const int jpegLumaTable[64] = {
+  16, 11, 10, 16, 24, 40, 51, 61,
+  12, 12, 14, 19, 26, 58, 60, 55,
+  14, 13, 16, 24, 40, 57, 69, 56,
+  14, 17, 22, 29, 51, 87, 80, 62,
+  18, 22, 37, 56, 68, 109, 103, 77,
+  24, 35, 55, 64, 81, 104, 113, 92,
+  49, 64, 78, 87, 103, 121, 120, 101,
+  72, 92, 95, 98, 112, 100, 103, 99
+};
+//JPEG (Annex K) chrominance quantization table, quality 50
+const int jpegChromaTable[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99,
+  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,
+  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99
+};
+//DWT dead zone: rounding offset when quantizing, reconstruction point inside a nonzero bin
+const double DWT_DEAD_ZONE_ROUNDING = 0.0;
+const double DWT_RECONSTRUCTION_BIAS = 0.375;
+//Step per coefficient of a block or subband row, with reciprocals so quantizing is a multiply
+struct Quantizer {
+  std::vector<double> step;
+  std::vector<double> reciprocal;
+  //0.5 rounds to nearest, less widens the zero bin
+  double rounding;
+  //Dequantized value is (|q| + bias) * step
+  double bias;
+};
+//Rectangle of DWT coefficients at one decomposition level
+struct Subband {
+  int y0, x0, h, w, level;
+};
+std::vector<Subband> dwtSubbands(int height, int width, int levels);
+std::vector<unsigned char> encodeImage(const std::vector<std::vector<double>> &red, const std::vector<std::vector<double>> &green, const std::vector<std::vector<double>> &blue, int width, int height, bool isDCT, int quality, Wavelet wavelet);
+//True if a stream header's width x height is within CODEC_MAX_DIMENSION and CODEC_MAX_PIXELS
+bool streamSizeValid(uint32_t width, uint32_t height);
+bool decodeImage(const std::vector<unsigned char> &file, std::vector<std::vector<double>> &red, std::vector<std::vector<double>> &green, std::vector<std::vector<double>> &blue, int &width, int &height);
+//Headless encoder/decoder entry points
+void runEncode(std::string imagePath, std::string outPath, int quality, bool isDCT);
+void runDecode(std::string inPath, std::string outPath);
+
+/**Embedded (SPIHT style) wavelet bitstream (.spt)**/
+const unsigned char EMBED_VERSION = 1;
+const int EMBED_MAX_LEVELS = 6;
+std::vector<unsigned char> encodeEmbedded(const std::vector<std::vector<double>> &red, const std::vector<std::vector<double>> &green, const std::vector<std::vector<double>> &blue, int width, int height, Wavelet wavelet);
+bool decodeEmbedded(const unsigned char *data, size_t size, std::vector<std::vector<double>> &red, std::vector<std::vector<double>> &green, std::vector<std::vector<double>> &blue, int &width, int &height);
+std::vector<unsigned char> readFilePrefix(std::string path, size_t bytes);
+//Decode a file prefix straight into a malloc'd RGB buffer
+unsigned char *decodeEmbeddedFile(std::string streamPath, size_t bytes, unsigned char *out = nullptr);
+void runEmbed(std::string imagePath, std::string outPath);
+void runTruncate(std::string inPath, size_t bytes, std::string outPath);
+
+/**
+ * Line-based (streaming) DWT.
+ * Every wavelet is a list of lifting operations on whole rows. Rows go in
+ * one at a time; operation s runs on row r - s - 1 when row r arrives, so a
+ * level only keeps a ring of (operations + 3) rows. Finished rows leave
+ * through the sink at their Mallat layout position, and the low half of
+ * every even row feeds the next level. Output matches outputDWT exactly.
+ **/
+enum LiftKind { LIFT_LINEAR, LIFT_PREDICT53, LIFT_UPDATE53, LIFT_HAAR_DIFF, LIFT_HAAR_AVG, LIFT_SCALE };
+struct LiftOp {
+  LiftKind kind;
+  //Rows this operation updates (0 = even / low, 1 = odd / high)
+  int parity;
+  double coeff;
+};
+std::vector<LiftOp> liftProgram(Wavelet wavelet);
+//Apply op to row xi, xl / xr are its (mirrored) neighbours, xr is NULL past the end for Haar
+void liftRow(const LiftOp &op, double *xi, const double *xl, const double *xr, int width);
+class StreamingDWT {
+ public:
+  //Receives count samples of Mallat layout row `row`, starting at column `col`
+  using RowSink = std::function<void(int row, int col, const double *data, int count)>;
+  StreamingDWT(int height, int width, Wavelet wavelet, int levels, RowSink sink);
+  void pushRow(const double *row);
+  //Samples held in the row rings, the whole working set
+  size_t bufferedSamples() const;
+
+ private:
+  struct Level {
+    int height;
+    int width;
+    int received = 0;
+    std::vector<std::vector<double>> ring;
+  };
+  void feed(int level, const double *input);
+  void advance(int level, int r);
+  void emit(int level, int i);
+  Wavelet wavelet;
+  std::vector<LiftOp> program;
+  std::vector<Level> levels;
+  std::vector<double> line;
+  int passedRows = 0;
+  RowSink sink;
+};
+//Headless --stream-dwt: planar .rgb in, planar float32 Mallat planes out, row by row
+void runStreamDWT(std::string imagePath, std::string outPath);
+
+/**Rate-distortion analysis**/
+const int SSIM_WINDOW = 8;
+const int SSIM_STRIDE = 4;
+struct ImageMetrics {
+  double mse;
+  double psnr;
+  double ssim;
+};
+void parallelFor(int count, int threads, const std::function<void(int, int)> &body);
+ImageMetrics computeMetrics(const unsigned char *ref, const unsigned char *test, int width, int height, int threads);
+void runRateDistortion(std::string csvPath, std::string mode, const std::vector<std::string> &imagePaths);
+//Headless --accuracy: every precision against the double reference
+void runAccuracy(std::string imagePath);
+
+/**Progressive export (--export)**/
+//One video file: YUV4MPEG2 4:4:4 full range, or raw interleaved RGB24 frames
+class VideoWriter {
+ public:
+  VideoWriter(std::string path, int width, int height, bool y4m);
+  //rgb = interleaved RGB buffer as returned by readImageData
+  void writeFrame(const unsigned char *rgb);
+  int frames = 0;
+
+ private:
+  std::ofstream file;
+  int width;
+  int height;
+  bool y4m;
+  std::vector<unsigned char> planes;
+};
+//DCT, DWT and side by side sequences of progressive part 1 or 2
+void runExport(std::string imagePath, std::string outPrefix, std::string mode, bool y4m);
+//Headless --reconstruct: DCT and DWT images from n coefficients, written as prefix_dct.rgb / prefix_dwt.rgb
+void runReconstruct(std::string imagePath, int n, std::string outPrefix);
+//Options and headless modes for the front ends
+Wavelet parseWavelet(const std::string &name);
+std::vector<std::string> parseOptions(const std::vector<std::string> &argv);
+void runHeadless(const std::vector<std::string> &args);
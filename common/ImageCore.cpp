@@ -0,0 +1,109 @@
+#include "ImageCore.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+using namespace std;
+
+#ifdef IMAGE_MEMORY
+/**
+ * Counting replacements of the global operator new / delete (plain,
+ * nothrow and over-aligned) for MemoryTrace.h. They have to live in exactly
+ * one translation unit, and every program links this one. In front of each
+ * returned pointer sits a header with the malloc'd block and the size asked
+ * for, so delete can take it off the live total.
+ */
+struct BlockHeader {
+  void *block;
+  size_t size;
+};
+static void *countedAllocate(size_t size, size_t alignment = alignof(max_align_t)){
+  alignment = max(alignment, alignof(max_align_t));
+  void *block = malloc(size + sizeof(BlockHeader) + alignment - 1);
+  if (block == nullptr){
+    return nullptr;
+  }
+  uintptr_t start = reinterpret_cast<uintptr_t>(block) + sizeof(BlockHeader);
+  uintptr_t aligned = (start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+  BlockHeader *header = reinterpret_cast<BlockHeader *>(aligned - sizeof(BlockHeader));
+  header->block = block;
+  header->size = size;
+  memtrace::recordAllocation(size);
+  return reinterpret_cast<void *>(aligned);
+}
+static void countedFree(void *pointer){
+  if (pointer == nullptr){
+    return;
+  }
+  const BlockHeader *header = reinterpret_cast<const BlockHeader *>(reinterpret_cast<uintptr_t>(pointer) - sizeof(BlockHeader));
+  memtrace::recordFree(header->size);
+  free(header->block);
+}
+static void *countedAllocateOrThrow(size_t size, size_t alignment = alignof(max_align_t)){
+  void *pointer = countedAllocate(size, alignment);
+  if (pointer == nullptr){
+    throw bad_alloc();
+  }
+  return pointer;
+}
+void *operator new(size_t size){ return countedAllocateOrThrow(size); }
+void *operator new[](size_t size){ return countedAllocateOrThrow(size); }
+void *operator new(size_t size, align_val_t alignment){ return countedAllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, align_val_t alignment){ return countedAllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void *operator new(size_t size, const nothrow_t &) noexcept { return countedAllocate(size); }
+void *operator new[](size_t size, const nothrow_t &) noexcept { return countedAllocate(size); }
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept { return countedAllocate(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept { return countedAllocate(size, static_cast<size_t>(alignment)); }
+void operator delete(void *pointer) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, const nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, const nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, align_val_t) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, align_val_t) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, size_t, align_val_t) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, size_t, align_val_t) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, align_val_t, const nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, align_val_t, const nothrow_t &) noexcept { countedFree(pointer); }
+#endif
+
+/**Function to transfer to inData**/
+unsigned char *transferInData(const vector<unsigned char> &red, const vector<unsigned char> &green, const vector<unsigned char> &blue, int width, int height){
+  TRACE_SCOPE("interleave");
+  /**
+   * Allocate a buffer to store the pixel values
+   * The data must be allocated with malloc(), NOT with operator new. wxWidgets
+   * library requires this.
+   */
+  unsigned char *inData = (unsigned char *)malloc(width * height * 3 * sizeof(unsigned char));
+
+  for (int i = 0; i < height * width; i++) {
+    // We populate RGB values of each pixel in that order
+    // RGB.RGB.RGB and so on for all pixels
+    inData[3 * i] = red[i];
+    inData[3 * i + 1] = green[i];
+    inData[3 * i + 2] = blue[i];
+  }
+  return inData;
+}
+
+/** Function to write an interleaved buffer back in the planar input layout */
+bool writePlanarRGB(const string &path, const unsigned char *rgb, int width, int height){
+  TRACE_SCOPE("write");
+  ofstream outputFile(path, ios::binary);
+  if (!outputFile.is_open()) {
+    return false;
+  }
+  size_t area = static_cast<size_t>(width) * height;
+  vector<char> plane(area);
+  for (int c = 0; c < 3; c++){
+    for (size_t i = 0; i < area; i++){
+      plane[i] = rgb[3 * i + c];
+    }
+    outputFile.write(plane.data(), area);
+  }
+  return outputFile.good();
+}
@@ -0,0 +1,30 @@
+#pragma once
+/**
+ * GUI-free image helpers shared by the assignments.
+ * Planar .rgb files are read through MappedRGBFile, converted to rows with
+ * to2D, and results leave as a malloc'd interleaved buffer (what wxImage
+ * takes over) or as a planar .rgb file for the command line front ends.
+ */
+#include <string>
+#include <vector>
+#include "MappedRGBFile.h"
+#include "Trace.h"
+
+/** Copy one channel view into rows of T */
+template <typename T> std::vector<std::vector<T>> to2D(const PlaneView &plane) {
+  TRACE_SCOPE("to2D");
+  std::vector<std::vector<T>> image2D(plane.height, std::vector<T>(plane.width));
+  for (int i = 0; i < plane.height; i++) {
+    const unsigned char *row = plane.row(i);
+    for (int j = 0; j < plane.width; j++) {
+      image2D[i][j] = static_cast<T>(row[j]);
+    }
+  }
+  return image2D;
+}
+
+/** Interleave three width * height planes into a malloc'd RGBRGB... buffer */
+unsigned char *transferInData(const std::vector<unsigned char> &red, const std::vector<unsigned char> &green, const std::vector<unsigned char> &blue, int width, int height);
+
+/** Write an interleaved RGB buffer as a planar RRR...GGG...BBB file, false if it cannot be written */
+bool writePlanarRGB(const std::string &path, const unsigned char *rgb, int width, int height);
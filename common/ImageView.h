@@ -0,0 +1,84 @@
+#pragma once
+/**
+ * Display layer of the wxWidgets front ends.
+ * The image lives in a retained bitmap that is written only when the image
+ * changes (one upload per new image or animation step). Paint events blit
+ * just their damaged rectangles out of that bitmap, so scrolling and window
+ * exposure never convert or copy the whole image. The bitmap is the front
+ * buffer; the caller's RGB buffer (a decoded frame) is the back buffer and
+ * can be reused as soon as show() returns.
+ */
+#include <memory>
+#include <wx/wx.h>
+#include <wx/rawbmp.h>
+#include "Trace.h"
+
+class ImageView {
+ public:
+  //window must outlive the view; its paint handler should call paint()
+  ImageView(wxScrolledWindow *window, int width, int height);
+  //Upload an interleaved RGB image of width * height pixels and repaint the image area
+  void show(const unsigned char *rgb);
+  //Paint the damaged part of the window, black beyond the image
+  void paint();
+
+ private:
+  wxScrolledWindow *window;
+  int width;
+  int height;
+  wxBitmap bitmap;
+};
+
+inline ImageView::ImageView(wxScrolledWindow *window, int width, int height)
+    : window(window), width(width), height(height), bitmap(width, height, 24) {
+  //paint() covers every damaged pixel, so skip the erase (and its flicker)
+  window->SetBackgroundStyle(wxBG_STYLE_PAINT);
+}
+
+inline void ImageView::show(const unsigned char *rgb) {
+  TRACE_SCOPE("upload");
+  wxNativePixelData pixels(bitmap);
+  if (pixels) {
+    wxNativePixelData::Iterator row(pixels);
+    for (int y = 0; y < height; y++) {
+      wxNativePixelData::Iterator p = row;
+      const unsigned char *src = rgb + static_cast<size_t>(y) * width * 3;
+      for (int x = 0; x < width; x++, ++p, src += 3) {
+        p.Red() = src[0];
+        p.Green() = src[1];
+        p.Blue() = src[2];
+      }
+      row.OffsetY(pixels, 1);
+    }
+  } else {
+    //No raw access on this port, convert through a wxImage that borrows the buffer
+    bitmap = wxBitmap(wxImage(width, height, const_cast<unsigned char *>(rgb), true));
+  }
+  int x;
+  int y;
+  window->CalcScrolledPosition(0, 0, &x, &y);
+  window->RefreshRect(wxRect(x, y, width, height), false);
+}
+
+inline void ImageView::paint() {
+  TRACE_SCOPE("paint");
+  wxPaintDC dc(window);
+  window->DoPrepareDC(dc);
+  wxMemoryDC source;
+  source.SelectObjectAsSource(bitmap);
+  dc.SetPen(*wxTRANSPARENT_PEN);
+  dc.SetBrush(*wxBLACK_BRUSH);
+  const wxRect image(0, 0, width, height);
+  for (wxRegionIterator damaged(window->GetUpdateRegion()); damaged; damaged++) {
+    //Update rectangles are in window coordinates, the DC is in scrolled ones
+    wxRect rect = damaged.GetRect();
+    window->CalcUnscrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
+    wxRect visible = rect.Intersect(image);
+    if (visible != rect) {
+      dc.DrawRectangle(rect);
+    }
+    if (!visible.IsEmpty()) {
+      dc.Blit(visible.x, visible.y, visible.width, visible.height, &source, visible.x, visible.y);
+    }
+  }
+}
@@ -0,0 +1,134 @@
+#pragma once
+/**
+ * Read-only, memory-mapped planar .rgb file shared by the assignments.
+ * The file (RRRR...GGGG...BBBB) is mapped once and each channel is exposed
+ * as a view straight into the mapping, so loading costs page faults only,
+ * with no read() into user buffers. On POSIX the mapping is advised for
+ * sequential read-ahead; on Windows the file is opened with the sequential
+ * scan hint.
+ * A sequence file holds whole frames back to back, each in the same
+ * planar layout.
+ */
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include "Trace.h"
+#ifdef _WIN32
+//The cores call min / max unqualified, so keep windows.h from defining them as macros
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** One channel of the file, width * height bytes in raster order */
+struct PlaneView {
+  const unsigned char *data;
+  int width;
+  int height;
+  const unsigned char *row(int y) const { return data + static_cast<size_t>(y) * width; }
+  unsigned char at(int y, int x) const { return data[static_cast<size_t>(y) * width + x]; }
+};
+
+class MappedRGBFile {
+ public:
+  //Maps path; prints the problem and exits if it cannot be opened or is not width * height * 3 bytes
+  //(with sequence, a nonzero multiple of that)
+  MappedRGBFile(const std::string &path, int width, int height, bool sequential = true, bool sequence = false);
+  ~MappedRGBFile();
+  MappedRGBFile(const MappedRGBFile &) = delete;
+  MappedRGBFile &operator=(const MappedRGBFile &) = delete;
+  //0 = red, 1 = green, 2 = blue
+  PlaneView plane(int channel, int frame = 0) const {
+    size_t area = static_cast<size_t>(width) * height;
+    return PlaneView{base + (static_cast<size_t>(frame) * 3 + channel) * area, width, height};
+  }
+  PlaneView red() const { return plane(0); }
+  PlaneView green() const { return plane(1); }
+  PlaneView blue() const { return plane(2); }
+  int width;
+  int height;
+  int frames = 1;
+
+ private:
+  const unsigned char *base = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+#endif
+};
+
+inline MappedRGBFile::MappedRGBFile(const std::string &path, int width, int height, bool sequential, bool sequence)
+    : width(width), height(height) {
+  TRACE_SCOPE("read");
+  size_t frameSize = static_cast<size_t>(width) * height * 3;
+  size_t expected = frameSize;
+  size_t actual = 0;
+#ifdef _WIN32
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                     sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL);
+  LARGE_INTEGER fileSize;
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize)) {
+    std::cerr << "Error Opening File for Reading" << std::endl;
+    exit(1);
+  }
+  actual = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    std::cerr << "Error Opening File for Reading" << std::endl;
+    exit(1);
+  }
+  actual = static_cast<size_t>(info.st_size);
+#endif
+  if (sequence && width > 0 && height > 0 && actual >= frameSize && actual % frameSize == 0) {
+    expected = actual;
+    frames = static_cast<int>(actual / frameSize);
+  }
+  if (width <= 0 || height <= 0 || actual != expected) {
+    std::cerr << path << " is " << actual << " bytes, a " << width << "x" << height
+              << " planar RGB " << (sequence ? "frame" : "image") << " is " << frameSize << " bytes" << std::endl;
+    exit(1);
+  }
+#ifdef _WIN32
+  mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  base = mapping ? static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+  if (base == nullptr) {
+    std::cerr << "Error Mapping " << path << std::endl;
+    exit(1);
+  }
+#else
+  void *address = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+  //The mapping keeps the file alive
+  close(fd);
+  if (address == MAP_FAILED) {
+    std::cerr << "Error Mapping " << path << std::endl;
+    exit(1);
+  }
+  if (sequential) {
+    madvise(address, expected, MADV_SEQUENTIAL);
+  }
+  base = static_cast<const unsigned char *>(address);
+#endif
+  size = expected;
+}
+
+inline MappedRGBFile::~MappedRGBFile() {
+#ifdef _WIN32
+  UnmapViewOfFile(base);
+  CloseHandle(mapping);
+  CloseHandle(file);
+#else
+  munmap(const_cast<unsigned char *>(base), size);
+#endif
+}
@@ -0,0 +1,157 @@
+#pragma once
+/**
+ * Heap accounting per pipeline stage, compiled in with -DIMAGE_MEMORY and
+ * compiled out entirely without it.
+ *
+ * The stages are the TRACE_SCOPE blocks of Trace.h, so every program gets
+ * the same stage names in its memory table as in its timing table. With
+ * IMAGE_MEMORY, ImageCore.cpp replaces the global operator new / delete
+ * with counting versions; each allocation is charged to every stage open
+ * on the allocating thread (stages nest, like the timers). Per stage the
+ * summary printed to cerr at exit gives
+ *   allocs / allocated  operator new calls and bytes asked for
+ *   peak                process-wide live heap at its highest, sampled at the
+ *                       stage's own allocations
+ *   growth              how far that peak rose above the live heap at stage entry,
+ *                       i.e. the stage's own transient footprint
+ * Buffers from malloc (the interleaved images handed to wxImage) bypass
+ * operator new and are not counted.
+ */
+#ifdef IMAGE_MEMORY
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace memtrace {
+
+/** One open stage on one thread */
+struct Frame {
+  const char *name;
+  Frame *parent;
+  uint64_t allocations;
+  uint64_t bytes;
+  int64_t entryLive;
+  int64_t peakLive;
+};
+
+struct Stage {
+  long calls = 0;
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+  int64_t peak = 0;
+  int64_t growth = 0;
+};
+
+//Process totals; constant initialized, so operator new can use them before main
+inline std::atomic<int64_t> liveBytes{0};
+inline std::atomic<int64_t> peakBytes{0};
+inline std::atomic<uint64_t> totalAllocations{0};
+inline std::atomic<uint64_t> totalBytes{0};
+//Innermost open stage of this thread
+inline thread_local Frame *currentFrame = nullptr;
+//Set while the bookkeeping itself allocates, so it is not charged to a stage
+inline thread_local bool bookkeeping = false;
+
+struct Registry {
+  std::mutex lock;
+  std::map<std::string, Stage> stages;
+};
+
+//Never destroyed, so allocations during exit still find it
+inline Registry &registry() {
+  static Registry *instance = new Registry();
+  return *instance;
+}
+
+//Called by the replaced operator new
+inline void recordAllocation(size_t size) {
+  int64_t live = liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+  int64_t peak = peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+  totalAllocations.fetch_add(1, std::memory_order_relaxed);
+  totalBytes.fetch_add(size, std::memory_order_relaxed);
+  if (bookkeeping) {
+    return;
+  }
+  for (Frame *frame = currentFrame; frame != nullptr; frame = frame->parent) {
+    frame->allocations++;
+    frame->bytes += size;
+    frame->peakLive = std::max(frame->peakLive, live);
+  }
+}
+
+//Called by the replaced operator delete
+inline void recordFree(size_t size) {
+  liveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+inline std::string megabytes(double bytes) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.2f", bytes / (1 << 20));
+  return text;
+}
+
+inline void report() {
+  bookkeeping = true;
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  //Largest transient footprint first
+  std::vector<std::pair<std::string, Stage>> rows(reg.stages.begin(), reg.stages.end());
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.second.growth > b.second.growth; });
+  char line[160];
+  snprintf(line, sizeof(line), "%-28s %8s %10s %14s %10s %10s", "stage", "calls", "allocs", "allocated MB", "peak MB", "growth MB");
+  std::cerr << "\nMemory summary (operator new)\n" << line << "\n";
+  for (const auto &row : rows) {
+    const Stage &s = row.second;
+    snprintf(line, sizeof(line), "%-28s %8ld %10llu %14s %10s %10s", row.first.c_str(), s.calls, static_cast<unsigned long long>(s.allocations),
+             megabytes(s.bytes).c_str(), megabytes(s.peak).c_str(), megabytes(s.growth).c_str());
+    std::cerr << line << "\n";
+  }
+  std::cerr << "process: peak " << megabytes(peakBytes.load()) << " MB, " << totalAllocations.load() << " allocations, "
+            << megabytes(totalBytes.load()) << " MB allocated, " << megabytes(liveBytes.load()) << " MB live at exit\n"
+            << std::flush;
+}
+
+class Scope {
+ public:
+  explicit Scope(const char *name) {
+    int64_t live = liveBytes.load(std::memory_order_relaxed);
+    frame = Frame{name, currentFrame, 0, 0, live, live};
+    currentFrame = &frame;
+  }
+  ~Scope() {
+    currentFrame = frame.parent;
+    bookkeeping = true;
+    {
+      Registry &reg = registry();
+      std::lock_guard<std::mutex> guard(reg.lock);
+      if (reg.stages.empty()) {
+        atexit(report);
+      }
+      Stage &stage = reg.stages[frame.name];
+      stage.calls++;
+      stage.allocations += frame.allocations;
+      stage.bytes += frame.bytes;
+      stage.peak = std::max(stage.peak, frame.peakLive);
+      stage.growth = std::max(stage.growth, frame.peakLive - frame.entryLive);
+    }
+    bookkeeping = false;
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+ private:
+  Frame frame;
+};
+
+}  // namespace memtrace
+
+#endif
@@ -0,0 +1,258 @@
+#pragma once
+/**
+ * Optional on-disk cache of finished images, shared by the resampling and
+ * segmentation front ends. Off unless $IMAGE_CACHE_DIR names a directory;
+ * $IMAGE_CACHE_MB caps its size (1024 by default).
+ *
+ * An entry is keyed by a hash of the input file's bytes plus a description
+ * of the operation and every parameter that changes the result, so renamed
+ * or copied inputs still hit and edited ones never do. Hashing a 36 MB input
+ * costs a pass over it, so the content hash of each input is remembered
+ * against its path, size and modification time.
+ *
+ * Entries are plain planar .rgb files (what the command line tools write),
+ * readable in place through MappedRGBFile. A hit refreshes the entry's
+ * modification time; inserting evicts the least recently used entries
+ * until the directory fits the cap. Entries are written to a temporary
+ * file and renamed, so concurrent processes only ever see whole entries.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "ImageCore.h"
+#include "MappedRGBFile.h"
+#include "Trace.h"
+
+/** 64 bit hash over four 8 byte lanes (multiply / rotate rounds in the style of xxHash64) */
+inline uint64_t hashBytes(const unsigned char *data, size_t size, uint64_t seed = 0) {
+  const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+  const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+  const uint64_t prime3 = 0x165667B19E3779F9ULL;
+  auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+  auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; };
+  auto word = [](const unsigned char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+  };
+  uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int l = 0; l < 4; l++) {
+      lanes[l] = round(lanes[l], word(data + i + 8 * l));
+    }
+  }
+  uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + size;
+  for (; i + 8 <= size; i += 8) {
+    h = rotl(h ^ round(0, word(data + i)), 27) * prime1 + prime3;
+  }
+  for (; i < size; i++) {
+    h = rotl(h ^ (data[i] * prime3), 11) * prime1;
+  }
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+inline std::string hexString(uint64_t value) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+  return text;
+}
+
+class ResultCache {
+ public:
+  //Configured from $IMAGE_CACHE_DIR and $IMAGE_CACHE_MB
+  ResultCache();
+  ResultCache(const std::string &directory, uintmax_t maxBytes);
+  bool enabled() const { return !directory.empty(); }
+  //Key of operation (with its parameters) applied to the width x height planar image at inputPath
+  std::string key(const std::string &inputPath, int width, int height, const std::string &operation);
+  //Copy the entry for key to outPath; false on a miss
+  bool copyTo(const std::string &key, const std::string &outPath);
+  //The entry for key as a malloc'd interleaved width x height buffer, NULL on a miss
+  unsigned char *loadImage(const std::string &key, int width, int height);
+  //Add a planar .rgb result file / an interleaved result under key
+  void storeFile(const std::string &key, const std::string &resultPath);
+  void storeImage(const std::string &key, const unsigned char *rgb, int width, int height);
+
+ private:
+  //Existing entry for key, marked as just used; empty on a miss
+  std::string find(const std::string &key);
+  //Temporary file to write an entry into before publish() renames it
+  std::string temporaryPath() const;
+  void publish(const std::string &temporary, const std::string &key);
+  //Delete least recently used entries until the directory fits maxBytes
+  void evict();
+  std::string directory;
+  uintmax_t maxBytes = 0;
+};
+
+inline ResultCache::ResultCache() {
+  const char *dir = getenv("IMAGE_CACHE_DIR");
+  const char *mb = getenv("IMAGE_CACHE_MB");
+  if (dir != nullptr && *dir != '\0') {
+    *this = ResultCache(dir, static_cast<uintmax_t>((mb != nullptr && atoll(mb) > 0) ? atoll(mb) : 1024) << 20);
+  }
+}
+
+inline ResultCache::ResultCache(const std::string &directory, uintmax_t maxBytes) : directory(directory), maxBytes(maxBytes) {
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (!std::filesystem::is_directory(directory, error)) {
+    std::cerr << "Cannot use " << directory << " as the result cache, continuing without it" << std::endl;
+    this->directory.clear();
+  }
+}
+
+inline std::string ResultCache::key(const std::string &inputPath, int width, int height, const std::string &operation) {
+  std::string op = hexString(hashBytes(reinterpret_cast<const unsigned char *>(operation.data()), operation.size()));
+  if (!enabled()) {
+    return op;
+  }
+  TRACE_SCOPE("cache key");
+  namespace fs = std::filesystem;
+  std::error_code error;
+  fs::path input = fs::absolute(inputPath, error);
+  auto modified = fs::last_write_time(input, error).time_since_epoch().count();
+  std::string stamp = input.string() + "|" + std::to_string(fs::file_size(input, error)) + "|" + std::to_string(modified);
+  fs::path memo = fs::path(directory) / (hexString(hashBytes(reinterpret_cast<const unsigned char *>(stamp.data()), stamp.size())) + ".input");
+  std::string content;
+  std::ifstream memoFile(memo);
+  if (!(memoFile >> content) || content.size() != 16) {
+    //Unknown or changed input: hash its bytes once and remember the result
+    MappedRGBFile file(inputPath, width, height);
+    content = hexString(hashBytes(file.red().data, static_cast<size_t>(width) * height * 3));
+    std::string temporary = temporaryPath();
+    std::ofstream(temporary) << content << "\n";
+    fs::rename(temporary, memo, error);
+    if (error) {
+      fs::remove(temporary, error);
+    }
+  } else {
+    fs::last_write_time(memo, fs::file_time_type::clock::now(), error);
+  }
+  return content + "-" + op;
+}
+
+inline std::string ResultCache::find(const std::string &key) {
+  if (!enabled()) {
+    return "";
+  }
+  std::filesystem::path entry = std::filesystem::path(directory) / (key + ".rgb");
+  std::error_code error;
+  //Touching the entry is the LRU bookkeeping
+  std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+  return error ? "" : entry.string();
+}
+
+inline bool ResultCache::copyTo(const std::string &key, const std::string &outPath) {
+  TRACE_SCOPE("cache copy");
+  std::string entry = find(key);
+  std::error_code error;
+  return !entry.empty() &&
+         std::filesystem::copy_file(entry, outPath, std::filesystem::copy_options::overwrite_existing, error) && !error;
+}
+
+inline unsigned char *ResultCache::loadImage(const std::string &key, int width, int height) {
+  TRACE_SCOPE("cache load");
+  std::string entry = find(key);
+  std::error_code error;
+  if (entry.empty() || std::filesystem::file_size(entry, error) != static_cast<uintmax_t>(width) * height * 3) {
+    return NULL;
+  }
+  MappedRGBFile file(entry, width, height);
+  size_t area = static_cast<size_t>(width) * height;
+  unsigned char *rgb = (unsigned char *)malloc(area * 3);
+  for (int c = 0; c < 3; c++) {
+    const unsigned char *plane = file.plane(c).data;
+    for (size_t i = 0; i < area; i++) {
+      rgb[3 * i + c] = plane[i];
+    }
+  }
+  return rgb;
+}
+
+inline std::string ResultCache::temporaryPath() const {
+  //Unique per process and thread, so concurrent writers never share one
+  static std::atomic<int> counter{0};
+  size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+  auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+  return (std::filesystem::path(directory) / (hexString(thread ^ now) + std::to_string(counter++) + ".tmp")).string();
+}
+
+inline void ResultCache::publish(const std::string &temporary, const std::string &key) {
+  std::error_code error;
+  std::filesystem::rename(temporary, std::filesystem::path(directory) / (key + ".rgb"), error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+  evict();
+}
+
+inline void ResultCache::storeFile(const std::string &key, const std::string &resultPath) {
+  if (!enabled()) {
+    return;
+  }
+  TRACE_SCOPE("cache store");
+  std::string temporary = temporaryPath();
+  std::error_code error;
+  if (std::filesystem::copy_file(resultPath, temporary, error)) {
+    publish(temporary, key);
+  } else {
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+inline void ResultCache::storeImage(const std::string &key, const unsigned char *rgb, int width, int height) {
+  if (!enabled()) {
+    return;
+  }
+  TRACE_SCOPE("cache store");
+  std::string temporary = temporaryPath();
+  if (writePlanarRGB(temporary, rgb, width, height)) {
+    publish(temporary, key);
+  } else {
+    std::error_code error;
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+inline void ResultCache::evict() {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  std::vector<std::tuple<fs::file_time_type, uintmax_t, fs::path>> entries;
+  uintmax_t total = 0;
+  for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+    //Another process's entry in progress is not ours to delete
+    std::error_code entryError;
+    if (!it->is_regular_file(entryError) || it->path().extension() == ".tmp") {
+      continue;
+    }
+    uintmax_t size = it->file_size(entryError);
+    fs::file_time_type used = it->last_write_time(entryError);
+    if (!entryError) {
+      entries.emplace_back(used, size, it->path());
+      total += size;
+    }
+  }
+  sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size() && total > maxBytes; i++) {
+    if (fs::remove(std::get<2>(entries[i]), error)) {
+      total -= std::get<1>(entries[i]);
+    }
+  }
+}
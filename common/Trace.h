@@ -0,0 +1,240 @@
+#pragma once
+/**
+ * Scoped timers and counters for the pipeline stages, compiled in with
+ * -DIMAGE_TRACE and compiled out entirely (the macros expand to nothing)
+ * without it.
+ *
+ *   TRACE_SCOPE("idct");              //times the enclosing block
+ *   TRACE_COUNTER("coefficients", n); //records a value at this instant
+ *
+ * Every thread records into its own fixed-size ring buffer, so the hot path
+ * is a clock read and a store with no lock. The first event of a thread
+ * registers its buffer; once full, a ring keeps the newest events. At exit
+ * the events are written as Chrome trace JSON (chrome://tracing or
+ * ui.perfetto.dev) to $IMAGE_TRACE_FILE, trace.json by default, and a
+ * per-stage summary table goes to cerr.
+ *
+ * The same TRACE_SCOPE blocks are the stages of the heap accounting in
+ * MemoryTrace.h (-DIMAGE_MEMORY); either flag works without the other.
+ */
+#include "MemoryTrace.h"
+#ifdef IMAGE_TRACE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef IMAGE_TRACE_RING
+//Events kept per thread, a power of two (32 bytes each)
+#define IMAGE_TRACE_RING (1 << 16)
+#endif
+static_assert((IMAGE_TRACE_RING & (IMAGE_TRACE_RING - 1)) == 0, "IMAGE_TRACE_RING must be a power of two");
+
+namespace trace {
+
+struct Event {
+  const char *name;   //string literal, never copied
+  int64_t start;      //ns since the first event of the process
+  int64_t duration;   //ns, -1 for a counter
+  double value;       //counter value
+};
+
+struct ThreadBuffer {
+  int tid;
+  std::vector<Event> events;
+  std::atomic<uint64_t> count{0};
+};
+
+struct Registry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+};
+
+//Never destroyed, so threads still running during exit keep a valid buffer
+inline Registry &registry() {
+  static Registry *instance = new Registry();
+  return *instance;
+}
+
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().origin).count();
+}
+
+//Escape a stage name for JSON (names are literals, this only guards quotes)
+inline std::string jsonString(const char *text) {
+  std::string out = "\"";
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+    }
+    out += *c;
+  }
+  return out + "\"";
+}
+
+inline void dump() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  const char *path = getenv("IMAGE_TRACE_FILE");
+  if (path == nullptr || *path == '\0') {
+    path = "trace.json";
+  }
+  FILE *file = fopen(path, "w");
+  if (file == nullptr) {
+    std::cerr << "Error Opening " << path << " for Writing" << std::endl;
+    return;
+  }
+  struct Stage {
+    long calls = 0;
+    int64_t total = 0;
+    int64_t max = 0;
+    double sum = 0;
+    bool counter = false;
+  };
+  std::map<std::string, Stage> stages;
+  uint64_t dropped = 0;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for (const auto &buffer : reg.buffers) {
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+            first ? "" : ",\n", buffer->tid, buffer->tid);
+    first = false;
+    uint64_t count = buffer->count.load(std::memory_order_acquire);
+    uint64_t begin = count > IMAGE_TRACE_RING ? count - IMAGE_TRACE_RING : 0;
+    dropped += begin;
+    for (uint64_t i = begin; i < count; i++) {
+      const Event &e = buffer->events[i & (IMAGE_TRACE_RING - 1)];
+      std::string name = jsonString(e.name);
+      Stage &stage = stages[e.name];
+      stage.calls++;
+      if (e.duration < 0) {
+        stage.counter = true;
+        stage.sum += e.value;
+        fprintf(file, ",\n{\"name\":%s,\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%g}}",
+                name.c_str(), e.start / 1000.0, buffer->tid, e.value);
+      } else {
+        stage.total += e.duration;
+        stage.max = std::max(stage.max, e.duration);
+        fprintf(file, ",\n{\"name\":%s,\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                name.c_str(), e.start / 1000.0, e.duration / 1000.0, buffer->tid);
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+
+  //Summary, slowest stage first; times are summed over threads
+  std::vector<std::pair<std::string, Stage>> rows(stages.begin(), stages.end());
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.second.total > b.second.total; });
+  char line[160];
+  snprintf(line, sizeof(line), "%-28s %8s %12s %12s %12s", "stage", "calls", "total ms", "mean us", "max us");
+  std::cerr << "\nTrace summary (" << path << ")\n" << line << "\n";
+  for (const auto &row : rows) {
+    const Stage &s = row.second;
+    if (s.counter) {
+      snprintf(line, sizeof(line), "%-28s %8ld %12s %12.6g %12s", row.first.c_str(), s.calls, "-", s.sum / s.calls, "(mean value)");
+    } else {
+      snprintf(line, sizeof(line), "%-28s %8ld %12.3f %12.3f %12.3f", row.first.c_str(), s.calls, s.total / 1e6,
+               s.total / 1e3 / s.calls, s.max / 1e3);
+    }
+    std::cerr << line << "\n";
+  }
+  if (dropped > 0) {
+    std::cerr << dropped << " oldest events were overwritten, raise IMAGE_TRACE_RING to keep them\n";
+  }
+  std::cerr << std::flush;
+}
+
+inline ThreadBuffer &threadBuffer() {
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (buffer == nullptr) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    if (reg.buffers.empty()) {
+      atexit(dump);
+    }
+    reg.buffers.emplace_back(new ThreadBuffer());
+    buffer = reg.buffers.back().get();
+    buffer->tid = static_cast<int>(reg.buffers.size()) - 1;
+    buffer->events.resize(IMAGE_TRACE_RING);
+  }
+  return *buffer;
+}
+
+inline void record(const char *name, int64_t start, int64_t duration, double value) {
+  ThreadBuffer &buffer = threadBuffer();
+  //Only this thread writes its ring, the release store publishes the event to dump()
+  uint64_t i = buffer.count.load(std::memory_order_relaxed);
+  buffer.events[i & (IMAGE_TRACE_RING - 1)] = Event{name, start, duration, value};
+  buffer.count.store(i + 1, std::memory_order_release);
+}
+
+class Scope {
+ public:
+  explicit Scope(const char *name) : name(name), start(now()) {}
+  ~Scope() { record(name, start, now() - start, 0); }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+ private:
+  const char *name;
+  int64_t start;
+};
+
+inline void counter(const char *name, double value) {
+  record(name, now(), -1, value);
+}
+
+}  // namespace trace
+
+#define TRACE_COUNTER(name, value) trace::counter(name, static_cast<double>(value))
+#else
+#define TRACE_COUNTER(name, value) ((void)0)
+#endif
+
+#if defined(IMAGE_TRACE) || defined(IMAGE_MEMORY)
+namespace trace {
+
+//Stands in for the half of a stage whose flag is off
+struct NoScope {
+  explicit NoScope(const char *) {}
+};
+#ifdef IMAGE_TRACE
+using StageTimer = Scope;
+#else
+using StageTimer = NoScope;
+#endif
+#ifdef IMAGE_MEMORY
+using StageMemory = memtrace::Scope;
+#else
+using StageMemory = NoScope;
+#endif
+
+/** A pipeline stage: timed with IMAGE_TRACE, heap accounted with IMAGE_MEMORY */
+class Stage {
+ public:
+  //The heap frame closes before the timer records, so the timer's own bookkeeping is not charged to the stage
+  explicit Stage(const char *name) : timer(name), memory(name) {}
+
+ private:
+  StageTimer timer;
+  StageMemory memory;
+};
+
+}  // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) trace::Stage TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
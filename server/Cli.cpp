@@ -0,0 +1,28 @@
+#include "JobServer.h"
+
+using namespace std;
+
+/**
+ * Job server front end.
+ * ./ImageServer socket [threads]           serve until a shutdown request
+ * ./ImageServer --client socket [job ...]  send the jobs (or the lines of stdin) and print the replies
+ */
+int main(int argc, char **argv) {
+  if (argc >= 3 && string(argv[1]) == "--client") {
+    vector<string> lines(argv + 3, argv + argc);
+    if (lines.empty()) {
+      string line;
+      while (getline(cin, line)) {
+        lines.push_back(line);
+      }
+    }
+    return sendJobs(argv[2], lines) ? 0 : 1;
+  }
+  if ((argc != 2 && argc != 3) || argv[1][0] == '-') {
+    cerr << "Usage: " << argv[0] << " socket [threads]" << endl;
+    cerr << "       " << argv[0] << " --client socket [job ...]" << endl;
+    return 1;
+  }
+  JobServer server(argc == 3 ? atoi(argv[2]) : 0);
+  return server.serve(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,551 @@
+#include "JobServer.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+//Jobs per kind the percentiles of the stats request are taken over
+const size_t RECENT_JOBS = 1024;
+//Forward transforms kept for the next compress jobs
+const size_t RECENT_COEFFICIENTS = 4;
+
+ThreadPool::ThreadPool(int threads) : tasks(4 * static_cast<size_t>(max(1, threads))) {
+  for (int i = 0; i < max(1, threads); i++){
+    workers.emplace_back([this]() {
+      function<void()> task;
+      while (tasks.pop(task)){
+        task();
+      }
+    });
+  }
+}
+ThreadPool::~ThreadPool(){
+  tasks.close();
+  for (thread &worker : workers){
+    worker.join();
+  }
+}
+void ThreadPool::submit(function<void()> task){
+  tasks.push(std::move(task));
+}
+
+static double milliseconds(JobClock::duration d){
+  return chrono::duration<double, milli>(d).count();
+}
+
+void JobMetrics::record(const string &kind, const Job &job){
+  lock_guard<mutex> guard(lock);
+  Kind &k = kinds[kind];
+  k.jobs++;
+  k.queueMs += milliseconds(job.started - job.received);
+  k.runMs += milliseconds(job.finished - job.started);
+  double total = milliseconds(job.finished - job.received);
+  if (k.recent.size() < RECENT_JOBS){
+    k.recent.push_back(total);
+  } else {
+    k.recent[k.next] = total;
+  }
+  k.next = (k.next + 1) % RECENT_JOBS;
+}
+string JobMetrics::summary(){
+  lock_guard<mutex> guard(lock);
+  if (kinds.empty()){
+    return "stats no jobs yet";
+  }
+  ostringstream out;
+  out << "stats" << fixed << setprecision(2);
+  for (const auto &entry : kinds){
+    const Kind &k = entry.second;
+    vector<double> totals = k.recent;
+    sort(totals.begin(), totals.end());
+    auto percentile = [&](double q) { return totals[min(totals.size() - 1, static_cast<size_t>(q * totals.size()))]; };
+    out << " | " << entry.first << " " << k.jobs << " jobs, queue mean " << k.queueMs / k.jobs << " ms, run mean " << k.runMs / k.jobs
+        << " ms, total p50 " << percentile(0.5) << " ms p95 " << percentile(0.95) << " ms max " << totals.back() << " ms";
+  }
+  return out.str();
+}
+
+/** Function to parse a whole decimal int */
+static bool toInt(const string &text, int &value){
+  char *end = nullptr;
+  long parsed = strtol(text.c_str(), &end, 10);
+  if (text.empty() || *end != '\0' || parsed < INT32_MIN || parsed > INT32_MAX){
+    return false;
+  }
+  value = static_cast<int>(parsed);
+  return true;
+}
+
+/** Function to check a planar .rgb input before a core maps it (the cores exit on a bad one) */
+static bool checkInput(const string &path, int width, int height, string &error){
+  error_code ec;
+  uintmax_t size = fs::file_size(path, ec);
+  if (ec){
+    error = "error cannot read " + path;
+    return false;
+  }
+  if (width <= 0 || height <= 0 || size != static_cast<uintmax_t>(width) * height * 3){
+    error = "error " + path + " is " + to_string(size) + " bytes, not a " + to_string(width) + "x" + to_string(height) + " planar RGB image";
+    return false;
+  }
+  return true;
+}
+
+JobServer::JobServer(int threads) : pool(threads > 0 ? threads : max(1u, thread::hardware_concurrency())) {
+  //Jobs run side by side, per channel and per step progress lines would only interleave
+  resampleLog = false;
+  compressionLog = false;
+  //Built once for every DCT job of the server's lifetime
+  cosTableU = outputCosineTableU(8, 8);
+  cosTableV = outputCosineTableV(8, 8);
+}
+
+vector<string> JobServer::runBatch(const vector<string> &lines){
+  JobClock::time_point received = JobClock::now();
+  vector<Job> jobs(lines.size());
+  vector<function<void()>> tasks;
+  //Resample jobs on the same input and size share one read and one pyramid
+  map<string, vector<Job *>> resampleGroups;
+  //Stats replies wait for the rest of the batch so they include its jobs
+  vector<Job *> statsJobs;
+  for (size_t i = 0; i < lines.size(); i++){
+    Job &job = jobs[i];
+    job.received = received;
+    istringstream words(lines[i]);
+    string word;
+    while (words >> word){
+      job.words.push_back(word);
+    }
+    string kind = job.words.empty() ? "" : job.words[0];
+    if (kind == "resample" && job.words.size() == 6){
+      resampleGroups[job.words[1] + " " + job.words[2] + " " + job.words[3]].push_back(&job);
+    } else if (kind == "segment" && (job.words.size() == 5 || job.words.size() == 7)){
+      tasks.push_back([this, &job]() { segment(job); });
+    } else if (kind == "compress" && (job.words.size() == 5 || job.words.size() == 7)){
+      tasks.push_back([this, &job]() { compress(job); });
+    } else if (kind == "stats" && job.words.size() == 1){
+      statsJobs.push_back(&job);
+    } else if (kind == "shutdown" && job.words.size() == 1){
+      stopping = true;
+      job.reply = "ok shutdown";
+    } else {
+      job.reply = "error expected resample input.rgb width height O1|O2|O3 output.rgb, segment input.rgb hue1 hue2 output.rgb [width height], "
+                  "compress input.rgb n dct|dwt output.rgb [width height], stats or shutdown";
+    }
+  }
+  for (auto &group : resampleGroups){
+    vector<Job *> groupJobs = group.second;
+    tasks.push_back([this, groupJobs]() { resampleGroup(groupJobs); });
+  }
+
+  //Every task of the batch goes to the shared pool, the batch replies when the last one is done
+  mutex doneLock;
+  condition_variable done;
+  size_t remaining = tasks.size();
+  for (function<void()> &task : tasks){
+    pool.submit([&, task]() {
+      task();
+      lock_guard<mutex> guard(doneLock);
+      remaining--;
+      done.notify_all();
+    });
+  }
+  {
+    unique_lock<mutex> guard(doneLock);
+    done.wait(guard, [&]() { return remaining == 0; });
+  }
+
+  for (Job &job : jobs){
+    if (job.started != JobClock::time_point()){
+      metrics.record(job.words[0], job);
+      if (job.reply.compare(0, 2, "ok") == 0){
+        ostringstream latency;
+        latency << fixed << setprecision(2) << " queue " << milliseconds(job.started - job.received) << " ms run "
+                << milliseconds(job.finished - job.started) << " ms total " << milliseconds(job.finished - job.received) << " ms";
+        if (job.cached){
+          latency << " cached";
+        }
+        if (job.batched > 1){
+          latency << " batched " << job.batched;
+        }
+        job.reply += latency.str();
+      }
+    }
+  }
+  for (Job *job : statsJobs){
+    job->reply = metrics.summary();
+  }
+  vector<string> replies;
+  for (size_t i = 0; i < jobs.size(); i++){
+    const Job &job = jobs[i];
+    cout << lines[i] << " -> " << job.reply << endl;
+    replies.push_back(job.reply);
+  }
+  return replies;
+}
+
+void JobServer::resampleGroup(const vector<Job *> &jobs){
+  TRACE_SCOPE("server resample");
+  JobClock::time_point started = JobClock::now();
+  const vector<string> &first = jobs[0]->words;
+  string input = first[1];
+  int width;
+  int height;
+  string error = "error width and height should be numbers";
+  if (!toInt(first[2], width) || !toInt(first[3], height) || !checkInput(input, width, height, error)){
+    for (Job *job : jobs){
+      job->reply = error;
+    }
+  } else {
+    //Formats the result cache does not have are resampled together
+    vector<Job *> missing;
+    vector<pair<int, int>> missingSizes;
+    vector<string> keys;
+    for (Job *job : jobs){
+      int outWidth;
+      int outHeight;
+      if (!outputFormatSize(job->words[4], outWidth, outHeight) || !canResample(width, outWidth)){
+        job->reply = "error cannot resample " + input + " to " + job->words[4];
+        continue;
+      }
+      string key = cache.key(input, width, height, resampleOperation(width, height, outWidth, outHeight));
+      if (cache.copyTo(key, job->words[5])){
+        job->reply = "ok resample " + job->words[5];
+        job->cached = true;
+        continue;
+      }
+      missing.push_back(job);
+      missingSizes.push_back(make_pair(outWidth, outHeight));
+      keys.push_back(key);
+    }
+    if (!missing.empty()){
+      vector<ResampledImage> images = resampleImageSizes(input, width, height, missingSizes);
+      for (size_t i = 0; i < missing.size(); i++){
+        const string &outPath = missing[i]->words[5];
+        if (writeResampledImage(outPath, images[i])){
+          cache.storeFile(keys[i], outPath);
+          missing[i]->reply = "ok resample " + outPath;
+        } else {
+          missing[i]->reply = "error cannot write " + outPath;
+        }
+      }
+    }
+  }
+  JobClock::time_point finished = JobClock::now();
+  for (Job *job : jobs){
+    job->started = started;
+    job->finished = finished;
+    job->batched = static_cast<int>(jobs.size());
+  }
+}
+
+void JobServer::segment(Job &job){
+  TRACE_SCOPE("server segment");
+  job.started = JobClock::now();
+  const vector<string> &w = job.words;
+  int hue1;
+  int hue2;
+  //All images of the assignment are 512x512
+  int width = 512;
+  int height = 512;
+  string error;
+  if (!toInt(w[2], hue1) || !toInt(w[3], hue2) || hue1 < 0 || hue2 > 360 || hue1 > hue2){
+    job.reply = "error hues should satisfy 0 <= hue1 <= hue2 <= 360";
+  } else if (w.size() == 7 && (!toInt(w[5], width) || !toInt(w[6], height))){
+    job.reply = "error width and height should be numbers";
+  } else if (!checkInput(w[1], width, height, error)){
+    job.reply = error;
+  } else {
+    string key = cache.key(w[1], width, height, hueFilterOperation(width, height, hue1, hue2));
+    if (cache.copyTo(key, w[4])){
+      job.cached = true;
+      job.reply = "ok segment " + w[4];
+    } else {
+      unsigned char *outData = hueFilterImage(w[1], width, height, hue1, hue2);
+      if (writePlanarRGB(w[4], outData, width, height)){
+        cache.storeFile(key, w[4]);
+        job.reply = "ok segment " + w[4];
+      } else {
+        job.reply = "error cannot write " + w[4];
+      }
+      free(outData);
+    }
+  }
+  job.finished = JobClock::now();
+}
+
+void JobServer::compress(Job &job){
+  TRACE_SCOPE("server compress");
+  job.started = JobClock::now();
+  const vector<string> &w = job.words;
+  int n;
+  int width = 0;
+  int height = 0;
+  string error;
+  if (w.size() == 5){
+    //Square images, like imageDimensions without --size
+    error_code ec;
+    uintmax_t size = fs::file_size(w[1], ec);
+    width = ec ? 0 : static_cast<int>(lround(sqrt(size / 3.0)));
+    height = width;
+  }
+  if (!toInt(w[2], n) || (w[3] != "dct" && w[3] != "dwt")){
+    job.reply = "error expected compress input.rgb n dct|dwt output.rgb [width height]";
+  } else if (w.size() == 7 && (!toInt(w[5], width) || !toInt(w[6], height))){
+    job.reply = "error width and height should be numbers";
+  } else if (!checkInput(w[1], width, height, error)){
+    job.reply = error;
+  } else if (n <= 0 || n > width * height){
+    job.reply = "error n should be between 1 and " + to_string(width * height);
+  } else {
+    bool isDCT = (w[3] == "dct");
+    shared_ptr<const ImageCoefficients> coeffs = coefficients(w[1], width, height, isDCT);
+    unsigned char *decoded = readImageData(*coeffs, n, isDCT, false);
+    job.reply = writePlanarRGB(w[4], decoded, width, height) ? "ok compress " + w[4] : "error cannot write " + w[4];
+    free(decoded);
+  }
+  job.finished = JobClock::now();
+}
+
+shared_ptr<const ImageCoefficients> JobServer::coefficients(const string &path, int width, int height, bool isDCT){
+  error_code ec;
+  string key = fs::absolute(path, ec).string() + "|" + to_string(fs::file_size(path, ec)) + "|" +
+               to_string(fs::last_write_time(path, ec).time_since_epoch().count()) + "|" + to_string(width) + "x" + to_string(height) +
+               (isDCT ? "|dct" : "|dwt");
+  promise<shared_ptr<const ImageCoefficients>> made;
+  shared_future<shared_ptr<const ImageCoefficients>> result;
+  bool build = false;
+  {
+    lock_guard<mutex> guard(coefficientLock);
+    auto found = find_if(recentCoefficients.begin(), recentCoefficients.end(), [&](const auto &entry) { return entry.first == key; });
+    if (found != recentCoefficients.end()){
+      recentCoefficients.splice(recentCoefficients.begin(), recentCoefficients, found);
+      result = found->second;
+    } else {
+      //Jobs on the same image that arrive meanwhile wait for this transform instead of repeating it
+      result = made.get_future().share();
+      recentCoefficients.emplace_front(key, result);
+      if (recentCoefficients.size() > RECENT_COEFFICIENTS){
+        recentCoefficients.pop_back();
+      }
+      build = true;
+    }
+  }
+  if (build){
+    auto coeffs = make_shared<ImageCoefficients>();
+    encodeCoefficients(loadImage2D(path, width, height), *coeffs, isDCT);
+    made.set_value(coeffs);
+  }
+  return result.get();
+}
+
+#ifndef _WIN32
+/** Function to write all of text to a socket */
+static bool sendAll(int socket, const string &text){
+  size_t sent = 0;
+  while (sent < text.size()){
+    ssize_t n = send(socket, text.data() + sent, text.size() - sent, 0);
+    if (n < 0 && errno == EINTR){
+      continue;
+    }
+    if (n <= 0){
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+/** Function to connect to a server socket, -1 if nothing listens there */
+static int connectTo(const string &socketPath){
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)){
+    return -1;
+  }
+  memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0){
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+void JobServer::connection(int socket){
+  string buffer;
+  char chunk[1 << 16];
+  bool open = true;
+  while (open){
+    ssize_t got = recv(socket, chunk, sizeof(chunk), 0);
+    if (got < 0 && errno == EINTR){
+      continue;
+    }
+    if (got > 0){
+      buffer.append(chunk, got);
+    } else {
+      //The client is done; a last line without a newline still counts
+      open = false;
+      if (!buffer.empty()){
+        buffer += '\n';
+      }
+    }
+    //Every complete line received so far is one batch
+    vector<string> lines;
+    size_t end;
+    while ((end = buffer.find('\n')) != string::npos){
+      string line = buffer.substr(0, end);
+      if (!line.empty() && line.back() == '\r'){
+        line.pop_back();
+      }
+      lines.push_back(line);
+      buffer.erase(0, end + 1);
+    }
+    if (!lines.empty()){
+      string replies;
+      for (const string &reply : runBatch(lines)){
+        replies += reply + "\n";
+      }
+      open = sendAll(socket, replies) && open;
+    }
+    if (stopping){
+      //Wake the accept loop so it sees the flag
+      int wake = connectTo(socketPath);
+      if (wake >= 0){
+        close(wake);
+      }
+      break;
+    }
+  }
+  //The client sees the end of the replies now; serve() closes the descriptor after the join
+  shutdown(socket, SHUT_RDWR);
+}
+
+bool JobServer::serve(const string &socketPath){
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)){
+    cerr << "Socket path " << socketPath << " is too long" << endl;
+    return false;
+  }
+  int running = connectTo(socketPath);
+  if (running >= 0){
+    close(running);
+    cerr << "A server is already listening on " << socketPath << endl;
+    return false;
+  }
+  memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  //Nothing answers there, so any file left is a stale socket of an earlier run
+  unlink(socketPath.c_str());
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0){
+    cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+    return false;
+  }
+  //A client that hangs up early must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+  this->socketPath = socketPath;
+  cout << "Serving on " << socketPath << " with " << pool.size() << " worker" << (pool.size() == 1 ? "" : "s") << endl;
+  while (!stopping){
+    int client = accept(listener, NULL, NULL);
+    if (client < 0){
+      if (errno == EINTR || errno == ECONNABORTED){
+        continue;
+      }
+      cerr << "accept failed: " << strerror(errno) << endl;
+      break;
+    }
+    if (stopping){
+      close(client);
+      break;
+    }
+    //Clients that have hung up since the last accept
+    for (auto it = connections.begin(); it != connections.end();){
+      if (it->finished){
+        it->worker.join();
+        close(it->socket);
+        it = connections.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    Connection &added = connections.emplace_back();
+    added.socket = client;
+    added.worker = thread([this, &added]() {
+      connection(added.socket);
+      added.finished = true;
+    });
+  }
+  close(listener);
+  unlink(socketPath.c_str());
+  //End every client (idle ones wait in recv; a running batch still finishes, but its reply is
+  //dropped) and join every thread, so none is left using the pool or the cache afterwards
+  for (Connection &client : connections){
+    shutdown(client.socket, SHUT_RDWR);
+  }
+  for (Connection &client : connections){
+    client.worker.join();
+    close(client.socket);
+  }
+  connections.clear();
+  cout << metrics.summary() << endl;
+  return true;
+}
+
+bool sendJobs(const string &socketPath, const vector<string> &lines){
+  int fd = connectTo(socketPath);
+  if (fd < 0){
+    cerr << "No job server on " << socketPath << endl;
+    return false;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  string request;
+  for (const string &line : lines){
+    request += line + "\n";
+  }
+  bool ok = sendAll(fd, request);
+  //End of requests, the server replies to all of them and closes
+  shutdown(fd, SHUT_WR);
+  string replies;
+  char chunk[1 << 16];
+  ssize_t got;
+  while ((got = recv(fd, chunk, sizeof(chunk), 0)) != 0){
+    if (got < 0){
+      if (errno == EINTR){
+        continue;
+      }
+      break;
+    }
+    replies.append(chunk, got);
+  }
+  close(fd);
+  cout << replies;
+  size_t count = 0;
+  for (size_t start = 0; start < replies.size();){
+    size_t end = replies.find('\n', start);
+    ok = ok && replies.compare(start, 5, "error") != 0;
+    count++;
+    start = (end == string::npos) ? replies.size() : end + 1;
+  }
+  return ok && count == lines.size();
+}
+#else
+void JobServer::connection(int socket){
+}
+bool JobServer::serve(const string &socketPath){
+  cerr << "The job server needs Unix domain sockets, which this build does not have" << endl;
+  return false;
+}
+bool sendJobs(const string &socketPath, const vector<string> &lines){
+  cerr << "The job server needs Unix domain sockets, which this build does not have" << endl;
+  return false;
+}
+#endif
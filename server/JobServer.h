@@ -0,0 +1,121 @@
+#pragma once
+/**
+ * Long-running job server for the three assignments. One process links the
+ * resampling, segmentation and compression cores and serves their jobs over
+ * a Unix domain socket, so a request pays neither process start-up nor the
+ * set-up that the cores keep between jobs: the cosine tables, the Gaussian
+ * kernel, the per-thread decode arenas and the forward transforms of
+ * recently compressed images stay warm.
+ *
+ * Protocol: newline terminated text, one reply line per request line, in
+ * request order.
+ *   resample input.rgb width height O1|O2|O3 output.rgb
+ *   segment input.rgb hue1 hue2 output.rgb [width height]
+ *   compress input.rgb n dct|dwt output.rgb [width height]
+ *   stats
+ *   shutdown
+ * Replies are "ok ..." with the job's latency, or "error ...".
+ *
+ * Lines that arrive together form a batch. Resample jobs of a batch on the
+ * same input become one task (one read, shared pyramid); every task runs on
+ * one shared thread pool.
+ */
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../1.Resampling/Resampling.h"
+#include "../2.ColorTheory/ColorSegmentation.h"
+#include "../3.DCTvsDWT-Compression/Compression.h"
+#include "../common/ResultCache.h"
+
+using JobClock = std::chrono::steady_clock;
+
+/** One request line and what happened to it */
+struct Job {
+  std::vector<std::string> words;
+  std::string reply;
+  bool cached = false;
+  int batched = 1;
+  JobClock::time_point received, started, finished;
+};
+
+/** Fixed set of worker threads shared by every connection */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int threads);
+  //Queued tasks still run before the workers exit
+  ~ThreadPool();
+  //Blocks while the queue is full
+  void submit(std::function<void()> task);
+  int size() const { return static_cast<int>(workers.size()); }
+
+ private:
+  BoundedQueue<std::function<void()>> tasks;
+  std::vector<std::thread> workers;
+};
+
+/** Latency of the recent jobs of each kind, for the stats request */
+class JobMetrics {
+ public:
+  void record(const std::string &kind, const Job &job);
+  //One line: per kind the job count, queue and run means, total p50 / p95 / max
+  std::string summary();
+
+ private:
+  struct Kind {
+    long jobs = 0;
+    double queueMs = 0;
+    double runMs = 0;
+    //Total latency of the newest jobs, the percentiles are over these
+    std::vector<double> recent;
+    size_t next = 0;
+  };
+  std::mutex lock;
+  std::map<std::string, Kind> kinds;
+};
+
+class JobServer {
+ public:
+  //threads = pool workers, 0 = one per core
+  explicit JobServer(int threads);
+  //Accept connections on socketPath until a shutdown request; false if the socket cannot be set up
+  bool serve(const std::string &socketPath);
+  //Run one batch of request lines, one reply per line
+  std::vector<std::string> runBatch(const std::vector<std::string> &lines);
+
+ private:
+  //Handlers fill job.reply (and job.cached); several jobs for a resample group
+  void resampleGroup(const std::vector<Job *> &jobs);
+  void segment(Job &job);
+  void compress(Job &job);
+  //Forward transform of an image, kept for the next jobs on it
+  std::shared_ptr<const ImageCoefficients> coefficients(const std::string &path, int width, int height, bool isDCT);
+  void connection(int socket);
+  //One accepted client; serve() closes the socket once the thread has been joined
+  struct Connection {
+    int socket = -1;
+    std::thread worker;
+    std::atomic<bool> finished{false};
+  };
+  ThreadPool pool;
+  JobMetrics metrics;
+  ResultCache cache;
+  //Transforms by path, size, modification time and method; newest first
+  std::mutex coefficientLock;
+  std::list<std::pair<std::string, std::shared_future<std::shared_ptr<const ImageCoefficients>>>> recentCoefficients;
+  std::atomic<bool> stopping{false};
+  //Open clients, only touched by the accept loop
+  std::list<Connection> connections;
+  std::string socketPath;
+};
+
+//Send each line to the server at socketPath and print the replies; false if it cannot connect or a job failed
+bool sendJobs(const std::string &socketPath, const std::vector<std::string> &lines);